@@ -14,33 +14,46 @@
 //  A  0  B  F                   Z  X  C  V 
 //                  
 
-uint8_t EventHandler::m_keymap[16] = {
-    SDLK_x,
-    SDLK_1,
-    SDLK_2,
-    SDLK_3,
-    SDLK_q,
-    SDLK_w,
-    SDLK_e,
-    SDLK_a,
-    SDLK_s,
-    SDLK_d,
-    SDLK_z,
-    SDLK_c,
-    SDLK_4,
-    SDLK_r,
-    SDLK_f,
-    SDLK_v,
+// Scancodes are physical key positions, so this layout stays put on AZERTY or Dvorak keyboards.
+SDL_Scancode EventHandler::m_default_keymap[CHIP8_KEY_SIZE] = {
+    SDL_SCANCODE_X,
+    SDL_SCANCODE_1,
+    SDL_SCANCODE_2,
+    SDL_SCANCODE_3,
+    SDL_SCANCODE_Q,
+    SDL_SCANCODE_W,
+    SDL_SCANCODE_E,
+    SDL_SCANCODE_A,
+    SDL_SCANCODE_S,
+    SDL_SCANCODE_D,
+    SDL_SCANCODE_Z,
+    SDL_SCANCODE_C,
+    SDL_SCANCODE_4,
+    SDL_SCANCODE_R,
+    SDL_SCANCODE_F,
+    SDL_SCANCODE_V,
 };
 
 EventHandler::EventHandler()
+    : m_chip8(nullptr), m_keys(0), m_held()
 {
-    // Nothing to setup.
+    ClearBindings();
+
+    for (uint8_t k = 0; k < CHIP8_KEY_SIZE; k++)
+        Bind(m_default_keymap[k], k);
+
+    // Most ROMs move with 2 / 4 / 6 / 8 and act with 5.
+    BindButton(SDL_CONTROLLER_BUTTON_DPAD_UP, 0x2);
+    BindButton(SDL_CONTROLLER_BUTTON_DPAD_LEFT, 0x4);
+    BindButton(SDL_CONTROLLER_BUTTON_DPAD_RIGHT, 0x6);
+    BindButton(SDL_CONTROLLER_BUTTON_DPAD_DOWN, 0x8);
+    BindButton(SDL_CONTROLLER_BUTTON_A, 0x5);
 };
 
 EventHandler::~EventHandler()
 {
-    // Nothing to deconstruct.
+    for (SDL_GameController* controller : m_controllers)
+        SDL_GameControllerClose(controller);
 };
 
 void EventHandler::Connect(CHIP8* chip8)
@@ -48,32 +61,204 @@ void EventHandler::Connect(CHIP8* chip8)
     m_chip8 = chip8;
 };
 
-void EventHandler::HandleEvent()
+void EventHandler::ClearBindings()
 {
-    SDL_Event e;
-    while (SDL_PollEvent(&e)) {
-        if (e.type == SDL_QUIT) exit(0);
-
-        // When given key is hit down, it should record 1 in CHPI8's key set.
-        if (e.type == SDL_KEYDOWN) {
-            // Allow user to exit the program by pressing ESC.
-            if (e.key.keysym.sym == SDLK_ESCAPE)
-                exit(0);
-
-            for (int i = 0; i < CHIP8_KEY_SIZE; ++i) {
-                if (e.key.keysym.sym == m_keymap[i]) {
-                    m_chip8->key[i] = 1;
-                }
-            }
+    // Keys held through the old bindings would never see their release.
+    _releaseAll();
+
+    for (int i = 0; i < SDL_NUM_SCANCODES; i++) m_scancodes[i] = EVENT_UNBOUND;
+    for (int i = 0; i < SDL_CONTROLLER_BUTTON_MAX; i++) m_buttons[i] = EVENT_UNBOUND;
+};
+
+void EventHandler::Bind(SDL_Scancode scancode, uint8_t key)
+{
+    if (scancode > SDL_SCANCODE_UNKNOWN && scancode < SDL_NUM_SCANCODES && key < CHIP8_KEY_SIZE)
+        m_scancodes[scancode] = static_cast<int8_t>(key);
+};
+
+void EventHandler::BindButton(SDL_GameControllerButton button, uint8_t key)
+{
+    if (button > SDL_CONTROLLER_BUTTON_INVALID && button < SDL_CONTROLLER_BUTTON_MAX && key < CHIP8_KEY_SIZE)
+        m_buttons[button] = static_cast<int8_t>(key);
+};
+
+bool EventHandler::LoadKeymap(const std::string& filepath)
+{
+    std::ifstream file(filepath);
+    if (!file)
+    {
+        printf("Keymap Error: Cannot open %s\n", filepath.c_str());
+        return false;
+    }
+
+    // A keymap file replaces every default binding.
+    ClearBindings();
+
+    auto trim = [](const std::string& text) {
+        size_t first = text.find_first_not_of(" \t\r");
+        size_t last = text.find_last_not_of(" \t\r");
+        return first == std::string::npos ? std::string() : text.substr(first, last - first + 1);
+    };
+
+    std::string line;
+    int number = 0;
+
+    while (std::getline(file, line))
+    {
+        number++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        // <CHIP-8 key> = <binding>, <binding>, ...
+        size_t equal = line.find('=');
+        std::string key_name = trim(line.substr(0, equal));
+        if (equal == std::string::npos || key_name.size() != 1 || !isxdigit(static_cast<unsigned char>(key_name[0])))
+        {
+            printf("Keymap Error: %s:%d: expected <0-F> = <bindings>\n", filepath.c_str(), number);
+            return false;
         }
+        uint8_t key = static_cast<uint8_t>(std::stoi(key_name, nullptr, 16));
+
+        std::string bindings = line.substr(equal + 1);
+        size_t start = 0;
+
+        while (start <= bindings.size())
+        {
+            size_t comma = bindings.find(',', start);
+            if (comma == std::string::npos)
+                comma = bindings.size();
+            std::string name = trim(bindings.substr(start, comma - start));
+            start = comma + 1;
+
+            if (name.empty())
+                continue;
 
-        // When given key is release, it should set back to 0 in CHIP8's key set.
-        if (e.type == SDL_KEYUP) {
-            for (int i = 0; i < CHIP8_KEY_SIZE; ++i) {
-                if (e.key.keysym.sym == m_keymap[i]) {
-                    m_chip8->key[i] = 0;
+            // Gamepad buttons use the SDL_GameController names with a pad: prefix, e.g. pad:a or pad:dpup.
+            if (name.compare(0, 4, "pad:") == 0)
+            {
+                SDL_GameControllerButton button = SDL_GameControllerGetButtonFromString(name.c_str() + 4);
+                if (button == SDL_CONTROLLER_BUTTON_INVALID)
+                {
+                    printf("Keymap Error: %s:%d: unknown gamepad button %s\n", filepath.c_str(), number, name.c_str());
+                    return false;
                 }
+                BindButton(button, key);
+                continue;
             }
+
+            // Everything else is an SDL scancode name, e.g. W, Up or Keypad 5.
+            SDL_Scancode scancode = SDL_GetScancodeFromName(name.c_str());
+            if (scancode == SDL_SCANCODE_UNKNOWN)
+            {
+                printf("Keymap Error: %s:%d: unknown key %s\n", filepath.c_str(), number, name.c_str());
+                return false;
+            }
+            Bind(scancode, key);
         }
     }
-}
\ No newline at end of file
+
+    return true;
+};
+
+void EventHandler::HandleEvent()
+{
+    SDL_Event e;
+    while (SDL_PollEvent(&e))
+        _handle(e);
+};
+
+void EventHandler::WaitEvent(int timeout_ms)
+{
+    // Sleeps in the OS until an event arrives, then takes whatever else queued up with it.
+    SDL_Event e;
+    if (SDL_WaitEventTimeout(&e, timeout_ms))
+    {
+        _handle(e);
+        HandleEvent();
+    }
+};
+
+uint16_t EventHandler::Keys() const
+{
+    return m_keys;
+};
+
+void EventHandler::_handle(const SDL_Event& e)
+{
+    if (e.type == SDL_QUIT) exit(0);
+
+    switch (e.type) {
+    case SDL_KEYDOWN:
+        // Allow user to exit the program by pressing ESC.
+        if (e.key.keysym.scancode == SDL_SCANCODE_ESCAPE)
+            exit(0);
+
+        // Auto-repeat would count the same binding twice.
+        if (!e.key.repeat)
+            _press(m_scancodes[e.key.keysym.scancode], true);
+        break;
+
+    case SDL_KEYUP:
+        _press(m_scancodes[e.key.keysym.scancode], false);
+        break;
+
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP:
+        if (e.cbutton.button < SDL_CONTROLLER_BUTTON_MAX)
+            _press(m_buttons[e.cbutton.button], e.type == SDL_CONTROLLERBUTTONDOWN);
+        break;
+
+    case SDL_CONTROLLERDEVICEADDED:
+    {
+        // Also sent at startup for every gamepad which is already plugged in.
+        SDL_GameController* controller = SDL_GameControllerOpen(e.cdevice.which);
+        if (controller != nullptr)
+            m_controllers.push_back(controller);
+        break;
+    }
+
+    case SDL_CONTROLLERDEVICEREMOVED:
+    {
+        SDL_GameController* controller = SDL_GameControllerFromInstanceID(e.cdevice.which);
+        auto it = std::find(m_controllers.begin(), m_controllers.end(), controller);
+        if (it != m_controllers.end())
+        {
+            SDL_GameControllerClose(controller);
+            m_controllers.erase(it);
+        }
+        // Its buttons will never be released, so let go of everything.
+        _releaseAll();
+        break;
+    }
+    }
+};
+
+void EventHandler::_press(int8_t key, bool down)
+{
+    if (key == EVENT_UNBOUND)
+        return;
+
+    // A key stays held until the last of its bindings is released.
+    if (down)
+        m_held[key]++;
+    else if (m_held[key] > 0)
+        m_held[key]--;
+
+    uint8_t held = m_held[key] > 0 ? 1 : 0;
+    m_keys = static_cast<uint16_t>((m_keys & ~(1u << key)) | (held << key));
+
+    if (m_chip8 != nullptr)
+        m_chip8->SetKey(key, held);
+};
+
+void EventHandler::_releaseAll()
+{
+    for (uint8_t k = 0; k < CHIP8_KEY_SIZE; k++)
+    {
+        m_held[k] = 0;
+        if (m_chip8 != nullptr)
+            m_chip8->SetKey(k, 0);
+    }
+    m_keys = 0;
+};
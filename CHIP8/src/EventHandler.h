@@ -3,17 +3,56 @@
 #include "pch.h"
 #include "CHIP8.h"
 
+// Marks scancodes and buttons which are not bound to any CHIP-8 key.
+#define EVENT_UNBOUND -1
+
+/* Event handler
+* Keyboard and gamepad input go through lookup tables indexed by SDL scancode and
+* SDL_GameController button, so every event costs one table read. Any number of
+* scancodes and buttons can be bound to the same CHIP-8 key.
+*/
 class EventHandler
 {
 public:
     EventHandler();
     ~EventHandler();
 
+    // Optional. The connected machine gets its keys set directly.
     void Connect(CHIP8* chip8);
 
+    // Replace every binding with the ones in a keymap file, see assets/keymap.cfg.
+    // Return false after printing the reason when the file cannot be used.
+    bool LoadKeymap(const std::string& filepath);
+
+    // Remove every binding and release every held key.
+    void ClearBindings();
+    void Bind(SDL_Scancode scancode, uint8_t key);
+    void BindButton(SDL_GameControllerButton button, uint8_t key);
+
+    // Handle every queued event.
     void HandleEvent();
+
+    // Block until an event arrives or timeout_ms passes, then handle every queued event.
+    void WaitEvent(int timeout_ms);
+
+    // Held keys as a mask, bit k for key k. Used to drive machines which are not connected, e.g. VecEnv.
+    uint16_t Keys() const;
 private:
-    static uint8_t m_keymap[16];
+    void _handle(const SDL_Event& e);
+    void _press(int8_t key, bool down);
+    void _releaseAll();
+private:
+    static SDL_Scancode m_default_keymap[CHIP8_KEY_SIZE];
 
     CHIP8 *m_chip8;
+    uint16_t m_keys;
+
+    // CHIP-8 key bound to every scancode and gamepad button, or EVENT_UNBOUND.
+    int8_t m_scancodes[SDL_NUM_SCANCODES];
+    int8_t m_buttons[SDL_CONTROLLER_BUTTON_MAX];
+
+    // Bindings currently held per CHIP-8 key.
+    uint8_t m_held[CHIP8_KEY_SIZE];
+
+    std::vector<SDL_GameController*> m_controllers;
 };
\ No newline at end of file
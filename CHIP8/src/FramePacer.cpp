@@ -0,0 +1,170 @@
+#include "pch.h"
+#include "FramePacer.h"
+
+#include <cmath>
+#include <vector>
+
+// Displays within this fraction of 60 Hz get emulated frames locked to their vertical blanks.
+#define PACER_LOCK_TOLERANCE 0.01
+// Weight of a new interval in the running refresh estimate.
+#define PACER_REFRESH_SMOOTHING 0.05
+
+static double Seconds(FramePacer::clock::duration d)
+{
+    return std::chrono::duration<double>(d).count();
+}
+
+FramePacer::FramePacer(Mode mode, int display_hz)
+    : m_mode(mode), m_refresh(1.0 / (display_hz > 0 ? display_hz : 60)), m_period(1.0 / 60), m_locked(false),
+      m_origin(clock::now()), m_ticks(0), m_last_present(m_origin), m_last_present_tick(0), m_late(0)
+{
+};
+
+FramePacer::Mode FramePacer::GetMode() const
+{
+    return m_mode;
+};
+
+bool FramePacer::Calibrate(Window& window)
+{
+    if (m_mode != PACE_VSYNC)
+        return false;
+
+    if (!window.VSync())
+    {
+        _fallback("the renderer does not support it");
+        return false;
+    }
+
+    std::vector<double> intervals;
+    window.Present(true);
+    clock::time_point last = clock::now();
+
+    for (unsigned int i = 0; i < PACER_CALIBRATION_PRESENTS; i++)
+    {
+        window.Present(true);
+        clock::time_point now = clock::now();
+        intervals.push_back(Seconds(now - last));
+        last = now;
+    }
+
+    double mean = 0.0, variance = 0.0;
+    for (double interval : intervals) mean += interval;
+    mean /= intervals.size();
+    for (double interval : intervals) variance += (interval - mean) * (interval - mean);
+    double deviation = std::sqrt(variance / intervals.size());
+
+    if (mean < 0.5 * m_refresh)
+    {
+        _fallback("presents do not wait for vertical blank");
+        return false;
+    }
+    if (mean > 2.5 * m_refresh || deviation > 0.2 * mean)
+    {
+        _fallback("present intervals are erratic");
+        return false;
+    }
+
+    m_refresh = mean;
+    m_locked = std::fabs(1.0 / mean - 60.0) < 60.0 * PACER_LOCK_TOLERANCE;
+    m_period = m_locked ? mean : 1.0 / 60;
+
+    printf("Vsync: %.2f Hz measured, %s\n", 1.0 / mean,
+        m_locked ? "frames locked to vertical blank" : "frames paced at 60 Hz");
+
+    // The first frame is due right away.
+    m_origin = last - std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(m_period));
+    m_ticks = 0;
+    m_last_present = last;
+    m_last_present_tick = 0;
+    return true;
+};
+
+unsigned int FramePacer::FramesDue()
+{
+    uint64_t ticks = static_cast<uint64_t>(Seconds(clock::now() - m_origin) / m_period);
+    if (ticks <= m_ticks)
+        return 0;
+
+    uint64_t due = ticks - m_ticks;
+    if (due > PACER_MAX_CATCHUP)
+    {
+        // Stalled for a while (window moved, debugger), skip the backlog instead of fast-forwarding.
+        m_ticks = ticks - PACER_MAX_CATCHUP;
+        due = PACER_MAX_CATCHUP;
+    }
+
+    m_ticks += due;
+    return static_cast<unsigned int>(due);
+};
+
+void FramePacer::WaitNextFrame()
+{
+    std::this_thread::sleep_until(_tick(m_ticks + 1));
+};
+
+bool FramePacer::Presented(clock::time_point before, clock::time_point after)
+{
+    if (m_mode != PACE_VSYNC)
+        return false;
+
+    if (Seconds(after - before) > PACER_LATE_REFRESHES * m_refresh)
+    {
+        if (++m_late >= PACER_LATE_LIMIT)
+        {
+            _fallback("presents keep blocking for several refreshes");
+            return false;
+        }
+    }
+    else
+    {
+        m_late = 0;
+    }
+
+    if (m_locked)
+    {
+        // Refine the refresh interval from presents on consecutive frames.
+        if (m_ticks == m_last_present_tick + 1)
+        {
+            double interval = Seconds(after - m_last_present);
+            if (interval > 0.5 * m_period && interval < 1.5 * m_period)
+                m_period += PACER_REFRESH_SMOOTHING * (interval - m_period);
+        }
+
+        // The present returned on a vertical blank, so the next frame is due right now.
+        // Emulating it then gives it a whole refresh before its own present.
+        m_origin = after - std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(m_period * (m_ticks + 1)));
+    }
+
+    m_last_present = after;
+    m_last_present_tick = m_ticks;
+    return true;
+};
+
+void FramePacer::Resync()
+{
+    m_origin = clock::now() - std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(m_period * m_ticks));
+    m_late = 0;
+};
+
+void FramePacer::WaitCycle(clock::time_point start) const
+{
+    auto elapsed = clock::now() - start;
+
+    long long delt_t = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+
+    // Since the timer counts in 60 Hz, put thread holds for 0.013ms each cycle.
+    if (delt_t < CHIP8_MICROSECOND_PER_CYCLE)
+        std::this_thread::sleep_for(std::chrono::microseconds(CHIP8_MICROSECOND_PER_CYCLE - delt_t));
+};
+
+void FramePacer::_fallback(const char* reason)
+{
+    printf("Vsync: %s, falling back to timer pacing.\n", reason);
+    m_mode = PACE_TIMER;
+};
+
+FramePacer::clock::time_point FramePacer::_tick(uint64_t tick) const
+{
+    return m_origin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(m_period * tick));
+};
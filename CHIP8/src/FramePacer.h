@@ -0,0 +1,83 @@
+#pragma once
+
+#include "pch.h"
+#include "Window.h"
+
+// Back-to-back presents measured before trusting vsync.
+#define PACER_CALIBRATION_PRESENTS 60
+// Most emulated frames run in one go after a stall, the rest of the backlog is skipped.
+#define PACER_MAX_CATCHUP 4
+// Presents blocking for longer than this many refreshes count as late.
+#define PACER_LATE_REFRESHES 3
+// Late presents in a row before falling back to timer pacing.
+#define PACER_LATE_LIMIT 8
+
+/* Frame pacer
+* Decides when the next emulated frame runs.
+*
+*   PACE_TIMER : every cycle sleeps for the rest of CHIP8_MICROSECOND_PER_CYCLE, as the emulator always did.
+*   PACE_VSYNC : frames are paced by the presents of a vsync renderer.
+*                On a display running at ~60 Hz, emulated frames are locked to its vertical blanks,
+*                using the measured refresh interval, so every refresh shows exactly one new frame.
+*                Other refresh rates keep a 60 Hz wall clock and only use vsync against tearing.
+*
+* Vsync is calibrated first. When presents do not wait for vertical blank, are erratic,
+* or later keep blocking for several refreshes (e.g. a hidden window), the pacer falls back to PACE_TIMER.
+*/
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    enum Mode : uint8_t
+    {
+        PACE_TIMER = 0,
+        PACE_VSYNC
+    };
+
+    // display_hz : refresh rate reported for the display, 0 when unknown.
+    FramePacer(Mode mode, int display_hz);
+
+    Mode GetMode() const;
+
+    // Vsync : measure back-to-back presents of window.
+    // Return false, after switching to PACE_TIMER, when vsync is unusable.
+    bool Calibrate(Window& window);
+
+    // Vsync : emulated frames due since the last call, at most PACER_MAX_CATCHUP.
+    unsigned int FramesDue();
+
+    // Vsync : sleep until the next emulated frame is due.
+    void WaitNextFrame();
+
+    // Vsync : report a present which was issued at before and returned at after.
+    // Return false, after switching to PACE_TIMER, when presents keep blocking for several refreshes.
+    bool Presented(clock::time_point before, clock::time_point after);
+
+    // Vsync : restart the frame timeline at now after emulation was idle on purpose,
+    // so the idle time is neither caught up nor counted as a stall.
+    void Resync();
+
+    // Timer : sleep for the rest of one cycle which started at start.
+    void WaitCycle(clock::time_point start) const;
+private:
+    void _fallback(const char* reason);
+    clock::time_point _tick(uint64_t tick) const;
+private:
+    Mode                m_mode;
+
+    // Seconds per refresh as reported by the display, and seconds per emulated frame.
+    double              m_refresh;
+    double              m_period;
+    // Emulated frames follow the vertical blanks.
+    bool                m_locked;
+
+    // Frame tick t is due at m_origin + t * m_period.
+    clock::time_point   m_origin;
+    uint64_t            m_ticks;
+
+    // Last present, to refine the measured refresh interval while locked.
+    clock::time_point   m_last_present;
+    uint64_t            m_last_present_tick;
+    unsigned int        m_late;
+};
@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "GridWindow.h"
+
+#include <algorithm>
+
+// Largest window side the grid is scaled up to.
+#define GRID_MAX_WINDOW 1536
+
+GridWindow::GridWindow(const std::string& name, unsigned int cols, unsigned int rows)
+    : m_window(nullptr), m_renderer(nullptr), m_texture(nullptr),
+      m_cols(cols ? cols : 1), m_rows(rows ? rows : 1),
+      m_x0(0), m_y0(0), m_x1(0), m_y1(0)
+{
+    m_width = m_cols * CHIP8_SCREEN_WIDTH + (m_cols - 1) * GRID_GAP;
+    m_height = m_rows * CHIP8_SCREEN_HEIGHT + (m_rows - 1) * GRID_GAP;
+
+    // Gaps keep their color forever, tiles start black until their first Update().
+    m_pixels.assign(static_cast<size_t>(m_width) * m_height, GRID_GAP_COLOR);
+    for (unsigned int t = 0; t < Tiles(); t++)
+        Update(t, nullptr, 0);
+
+    // Scale up by a whole factor as long as the window fits.
+    unsigned int scale = std::max(1u, std::min(GRID_MAX_WINDOW / m_width, GRID_MAX_WINDOW / m_height));
+
+    m_window = SDL_CreateWindow(
+        name.c_str(),
+        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+        m_width * scale, m_height * scale, SDL_WINDOW_SHOWN
+    );
+
+    if (m_window == NULL)
+    {
+        printf("SDL_Error: %s\n", SDL_GetError());
+        exit(1);
+    }
+
+    m_renderer = SDL_CreateRenderer(m_window, -1, 0);
+    SDL_RenderSetLogicalSize(m_renderer, m_width, m_height);
+
+    m_texture = SDL_CreateTexture(m_renderer,
+        SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+        m_width, m_height);
+
+    if (m_renderer == NULL || m_texture == NULL)
+    {
+        printf("SDL_Error: %s\n", SDL_GetError());
+        exit(1);
+    }
+};
+
+GridWindow::~GridWindow()
+{
+    SDL_DestroyTexture(m_texture);
+    SDL_DestroyRenderer(m_renderer);
+    SDL_DestroyWindow(m_window);
+};
+
+unsigned int GridWindow::Tiles() const
+{
+    return m_cols * m_rows;
+};
+
+void GridWindow::Update(unsigned int tile, const uint8_t* screen, uint32_t dirty_rows)
+{
+    if (tile >= Tiles())
+        return;
+
+    unsigned int x = (tile % m_cols) * (CHIP8_SCREEN_WIDTH + GRID_GAP);
+    unsigned int y = (tile / m_cols) * (CHIP8_SCREEN_HEIGHT + GRID_GAP);
+    uint32_t* origin = m_pixels.data() + static_cast<size_t>(y) * m_width + x;
+    int pitch = static_cast<int>(m_width * sizeof(uint32_t));
+
+    if (screen == nullptr)
+    {
+        // Blank tile.
+        for (unsigned int r = 0; r < CHIP8_SCREEN_HEIGHT; r++)
+            std::fill(origin + r * m_width, origin + r * m_width + CHIP8_SCREEN_WIDTH, 0xFF000000);
+        dirty_rows = CHIP8_ALL_ROWS;
+    }
+
+    unsigned int first_dirty = CHIP8_SCREEN_HEIGHT, last_dirty = 0;
+    unsigned int r = 0;
+
+    while (r < CHIP8_SCREEN_HEIGHT)
+    {
+        if (!(dirty_rows & (1u << r)))
+        {
+            r++;
+            continue;
+        }
+
+        unsigned int first = r;
+        while (r < CHIP8_SCREEN_HEIGHT && (dirty_rows & (1u << r)))
+            r++;
+
+        if (screen != nullptr)
+            m_converter.ConvertBytes(screen, first, r - first, origin + first * m_width, pitch);
+
+        first_dirty = std::min(first_dirty, first);
+        last_dirty = r;
+    }
+
+    if (first_dirty >= last_dirty)
+        return;
+
+    // Grow the area Present() uploads.
+    if (m_x0 >= m_x1)
+    {
+        m_x0 = x; m_x1 = x + CHIP8_SCREEN_WIDTH;
+        m_y0 = y + first_dirty; m_y1 = y + last_dirty;
+    }
+    else
+    {
+        m_x0 = std::min(m_x0, x); m_x1 = std::max(m_x1, x + CHIP8_SCREEN_WIDTH);
+        m_y0 = std::min(m_y0, y + first_dirty); m_y1 = std::max(m_y1, y + last_dirty);
+    }
+};
+
+bool GridWindow::Present()
+{
+    if (m_x0 >= m_x1)
+        return false;
+
+    // One upload for every tile which changed. The rect points into the staging buffer with its full pitch.
+    SDL_Rect rect = { static_cast<int>(m_x0), static_cast<int>(m_y0),
+                      static_cast<int>(m_x1 - m_x0), static_cast<int>(m_y1 - m_y0) };
+    const uint32_t* pixels = m_pixels.data() + static_cast<size_t>(m_y0) * m_width + m_x0;
+    SDL_UpdateTexture(m_texture, &rect, pixels, static_cast<int>(m_width * sizeof(uint32_t)));
+
+    SDL_RenderClear(m_renderer);
+    SDL_RenderCopy(m_renderer, m_texture, NULL, NULL);
+    SDL_RenderPresent(m_renderer);
+
+    m_x0 = m_x1 = 0;
+    return true;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "pch.h"
+#include "CHIP8.h"
+#include "FramebufferConverter.h"
+
+// Pixels between two tiles of the grid.
+#define GRID_GAP 1
+#define GRID_GAP_COLOR 0xFF303030
+
+/* Grid window
+* Shows cols * rows CHIP-8 screens side by side in one SDL window, e.g. to monitor a VecEnv batch.
+* Every tile lives in one large streaming texture. Update() only converts the rows of a tile which
+* changed into a staging buffer, and Present() uploads the area touched since the last present with
+* a single SDL_UpdateTexture before a single present.
+*/
+class GridWindow
+{
+public:
+    GridWindow(const std::string& name, unsigned int cols, unsigned int rows);
+    ~GridWindow();
+
+    unsigned int Tiles() const;
+
+    // Convert the rows set in dirty_rows (CHIP8::TakeDirtyRows()) of tile's 64*32 screen.
+    void Update(unsigned int tile, const uint8_t* screen, uint32_t dirty_rows);
+
+    // Upload what changed and present. Return false, without presenting, when no tile changed.
+    bool Present();
+private:
+    SDL_Window      *m_window;
+    SDL_Renderer    *m_renderer;
+    SDL_Texture     *m_texture;
+
+    unsigned int    m_cols, m_rows;
+    // Size of the whole grid texture in pixels.
+    unsigned int    m_width, m_height;
+
+    // ARGB copy of the texture, written by Update() and uploaded by Present().
+    std::vector<uint32_t> m_pixels;
+    FramebufferConverter m_converter;
+
+    // Bounding box [x0, x1) * [y0, y1) of the pixels changed since the last Present(), empty when x0 >= x1.
+    unsigned int    m_x0, m_y0, m_x1, m_y1;
+};
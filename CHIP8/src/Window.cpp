@@ -3,8 +3,9 @@
 #include "pch.h"
 #include "Window.h"
 
-Window::Window(const std::string& name, unsigned int w, unsigned int h)
-    : m_window(nullptr), m_renderer(nullptr), m_texture(nullptr), m_chip8(nullptr)
+Window::Window(const std::string& name, unsigned int w, unsigned int h, bool vsync)
+    : m_window(nullptr), m_renderer(nullptr), m_texture(nullptr), m_w(w), m_h(h), m_vsync(false),
+      m_chip8(nullptr), m_pending(false), m_run_ahead(nullptr), m_recorder(nullptr), m_cycles(0), m_frames(0)
 {
     m_window = SDL_CreateWindow(
         "CHIP-8 Emulator",
@@ -18,20 +19,14 @@ Window::Window(const std::string& name, unsigned int w, unsigned int h)
         exit(1);
     }
 
-    m_renderer = SDL_CreateRenderer(m_window, -1, 0);
-    SDL_RenderSetLogicalSize(m_renderer, w, h);
-
-    // Creaet a texture to represent entire screen.
-    m_texture = SDL_CreateTexture(m_renderer,
-        SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
-        CHIP8_SCREEN_WIDTH, CHIP8_SCREEN_HEIGHT);
+    _createRenderer(vsync);
 };
 
 Window::~Window()
 {
-    SDL_DestroyWindow(m_window);
-    SDL_DestroyRenderer(m_renderer);
     SDL_DestroyTexture(m_texture);
+    SDL_DestroyRenderer(m_renderer);
+    SDL_DestroyWindow(m_window);
 };
 
 void Window::Connect(CHIP8* chip8)
@@ -39,7 +34,59 @@ void Window::Connect(CHIP8* chip8)
     m_chip8 = chip8;
 };
 
+void Window::Record(FrameRecorder* recorder)
+{
+    m_recorder = recorder;
+};
+
+void Window::Predict(RunAhead* run_ahead)
+{
+    m_run_ahead = run_ahead;
+};
+
+bool Window::VSync() const
+{
+    return m_vsync;
+};
+
+int Window::RefreshRate() const
+{
+    SDL_DisplayMode mode;
+    if (SDL_GetWindowDisplayMode(m_window, &mode) != 0)
+        return 0;
+    return mode.refresh_rate;
+};
+
+void Window::DisableVSync()
+{
+    if (!m_vsync)
+        return;
+
+    // SDL 2.0.12 cannot switch vsync on a live renderer, so build a new one without it.
+    SDL_DestroyTexture(m_texture);
+    SDL_DestroyRenderer(m_renderer);
+    _createRenderer(false);
+
+    // The new texture starts empty.
+    if (m_chip8 != nullptr)
+        _upload(CHIP8_ALL_ROWS);
+    m_pending = true;
+};
+
 void Window::Draw()
+{
+    m_cycles++;
+
+    // Upload at most once per 60 Hz frame. A ROM draws its scene with many DXYN in a row,
+    // presenting after each of them would show half-drawn scenes and flood the GPU with presents.
+    // The dirty rows of every sprite drawn during the frame are collected and uploaded together.
+    if (m_cycles % CHIP8_CYCLES_PER_FRAME != 0)
+        return;
+
+    DrawFrame();
+};
+
+void Window::DrawFrame()
 {
     if (m_chip8 == nullptr)
     {
@@ -47,28 +94,120 @@ void Window::Draw()
         exit(1);
     }
 
-    // Pixels buffer for rendering.
-    // Using 4 bytes to represent color.
-    uint32_t pixels[CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT];
+    m_frames++;
+
+    if (m_run_ahead != nullptr)
+    {
+        // Predict on every frame, the keys held now can change the future even when this frame drew nothing.
+        m_chip8->draw_flag = 0;
+        m_run_ahead->Predict(*m_chip8);
+
+        uint32_t rows = m_run_ahead->TakeDirtyRows();
+        if (rows != 0)
+        {
+            _upload(rows);
+            m_pending = true;
+
+            // What the player saw, which runs FramesAhead() frames ahead of the machine.
+            if (m_recorder != nullptr)
+                m_recorder->Push(m_run_ahead->Screen(), m_frames);
+        }
+        return;
+    }
+
+    // Restore() marks every row dirty without drawing, e.g. when netplay rolls back a predicted frame.
+    uint32_t rows = m_chip8->TakeDirtyRows();
 
-    if (m_chip8->draw_flag) {
+    if (m_chip8->draw_flag || rows != 0) {
         m_chip8->draw_flag = 0;
 
-        for (int i = 0; i < CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT; ++i) {
-            uint32_t pixel = static_cast<uint32_t>(m_chip8->screen[i]);
-            // White == 0xFFFFFFFF ; Black == 0xFF000000;
-            //
-            // if pixel == 1 => Draw White block on screen.
-            // else          => Draw Black block on screen.
-            pixels[i] = (0x00FFFFFF * pixel) | 0xFF000000;
+        // Only rows changed since the last upload are written, straight into the texture memory.
+        // Nothing is uploaded at all when the drawn sprites did not change any pixel.
+        _upload(rows);
+        m_pending = true;
+
+        // The recorder only queues the frame, the file is written on its own thread.
+        if (m_recorder != nullptr)
+            m_recorder->Push(m_chip8->screen, m_frames);
+    }
+};
+
+bool Window::Present(bool force)
+{
+    if (!m_pending && !force)
+        return false;
+    m_pending = false;
+
+    SDL_RenderClear(m_renderer);
+    SDL_RenderCopy(m_renderer, m_texture, NULL, NULL);
+    SDL_RenderPresent(m_renderer);
+    return true;
+};
+
+void Window::_createRenderer(bool vsync)
+{
+    Uint32 flags = vsync ? SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC : 0;
+
+    m_renderer = SDL_CreateRenderer(m_window, -1, flags);
+    if (m_renderer == NULL && flags != 0)
+    {
+        printf("Window: No accelerated vsync renderer (%s), using the default one.\n", SDL_GetError());
+        m_renderer = SDL_CreateRenderer(m_window, -1, 0);
+    }
+
+    if (m_renderer == NULL)
+    {
+        printf("SDL_Error: %s\n", SDL_GetError());
+        exit(1);
+    }
+
+    // Drivers may ignore the request, so ask the renderer what it actually does.
+    SDL_RendererInfo info;
+    m_vsync = SDL_GetRendererInfo(m_renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC);
+
+    SDL_RenderSetLogicalSize(m_renderer, m_w, m_h);
+
+    // Creaet a texture to represent entire screen.
+    m_texture = SDL_CreateTexture(m_renderer,
+        SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+        CHIP8_SCREEN_WIDTH, CHIP8_SCREEN_HEIGHT);
+};
+
+const uint8_t* Window::_screen() const
+{
+    return m_run_ahead != nullptr ? m_run_ahead->Screen() : m_chip8->screen;
+};
+
+void Window::_upload(uint32_t rows)
+{
+    int y = 0;
+
+    while (rows != 0 && y < CHIP8_SCREEN_HEIGHT)
+    {
+        // Skip clean rows, then take the whole run of dirty rows which follows.
+        if (!(rows & (1u << y)))
+        {
+            y++;
+            continue;
         }
-        
-        // SDL has to know to decode data inside pixels buffer.
-        // Since there should be 64 pixels in each row and each pixel is 4 bytes long,
-        // the pitch value should set to 64 * sizeof(Uint32).
-        SDL_UpdateTexture(m_texture, NULL, pixels, 64 * sizeof(Uint32));
-        SDL_RenderClear(m_renderer);
-        SDL_RenderCopy(m_renderer, m_texture, NULL, NULL);
-        SDL_RenderPresent(m_renderer);
+
+        int first = y;
+        while (y < CHIP8_SCREEN_HEIGHT && (rows & (1u << y)))
+            rows &= ~(1u << y++);
+
+        // Locked pixels are write-only and may not hold the old texture data,
+        // so lock exactly the run and write every pixel of it.
+        SDL_Rect rect = { 0, first, CHIP8_SCREEN_WIDTH, y - first };
+        void* locked;
+        int pitch;
+        if (SDL_LockTexture(m_texture, &rect, &locked, &pitch) != 0)
+        {
+            printf("SDL_Error: %s\n", SDL_GetError());
+            exit(1);
+        }
+
+        m_converter.ConvertBytes(_screen(), first, y - first, locked, pitch);
+
+        SDL_UnlockTexture(m_texture);
     }
-}
\ No newline at end of file
+};
\ No newline at end of file
@@ -2,20 +2,63 @@
 
 #include "pch.h"
 #include "CHIP8.h"
+#include "FrameRecorder.h"
+#include "FramebufferConverter.h"
+#include "RunAhead.h"
 
 class Window
 {
 public:
-    Window(const std::string& name, unsigned int w, unsigned int h);
+    // vsync asks for an accelerated renderer which presents on vertical blank, see VSync().
+    Window(const std::string& name, unsigned int w, unsigned int h, bool vsync = false);
     ~Window();
 
     void Connect(CHIP8* chip8);
 
+    // Capture every drawn frame into recorder. nullptr stops recording.
+    void Record(FrameRecorder* recorder);
+
+    // Show the screens predicted by run_ahead instead of the machine's own. nullptr shows the machine again.
+    void Predict(RunAhead* run_ahead);
+
+    // True when the renderer really waits for vertical blank in Present().
+    bool VSync() const;
+    // Refresh rate of the display the window is on, 0 when unknown.
+    int RefreshRate() const;
+    // Rebuild the renderer without vsync, for hosts where it turns out to be unusable.
+    void DisableVSync();
+
+    // Called once per emulated cycle. Uploads the screen on 60 Hz frame boundaries when it changed.
     void Draw();
+    // Same as a frame boundary of Draw(), for callers which run whole frames.
+    void DrawFrame();
+
+    // Present the last uploaded frame. Only presents when a new frame was uploaded since, unless force.
+    // Return true when it presented, which blocks until vertical blank when VSync() is true.
+    bool Present(bool force = false);
+private:
+    void _createRenderer(bool vsync);
+    // Screen which is shown, predicted or real.
+    const uint8_t* _screen() const;
+    // Convert the rows set in the rows mask into the streaming texture.
+    void _upload(uint32_t rows);
 private:
     SDL_Window      *m_window;
     SDL_Renderer    *m_renderer;
     SDL_Texture     *m_texture;
+    unsigned int    m_w, m_h;
+    bool            m_vsync;
 
     CHIP8           *m_chip8;
+    // A frame was uploaded and not presented yet.
+    bool            m_pending;
+
+    // White on black, vectorized when the CPU allows it.
+    FramebufferConverter m_converter;
+
+    RunAhead        *m_run_ahead;
+    FrameRecorder   *m_recorder;
+    // Draw() is called once per emulated cycle, so this counts cycles. DrawFrame() counts frames.
+    uint64_t        m_cycles;
+    uint64_t        m_frames;
 };
\ No newline at end of file
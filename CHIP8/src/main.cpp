@@ -2,13 +2,294 @@
 
 #include "CHIP8.h"
 #include "Window.h"
+#include "FramePacer.h"
+#include "GridWindow.h"
 #include "EventHandler.h"
 #include "AudioPlayer.h"
+#include "FrameRecorder.h"
+#include "AudioRecorder.h"
+#include "SharedFrame.h"
+#include "VecEnv.h"
+#include "RunAhead.h"
+#include "NetTransport.h"
+#include "Netplay.h"
+
+// Longest block on input while the ROM waits for a key. Events wake it earlier.
+#define IDLE_WAIT_MS 100
+// Headless netplay keeps answering the peer this long after both sides have every input, so it hears our last ack.
+#define NETPLAY_LINGER_MS 500
+
+#define USAGE "Usage : ./CHIP8-Emulator [--shm <name>] [--record <file.y4m|file.rle>] [--record-audio <file.wav>] [--headless <frames>] [--vsync] [--grid <cols>x<rows>] [--keymap <file>] [--run-ahead <frames>] [--netplay <transport>] [--net-latency <ms>] [--net-jitter <ms>] [--net-loss <percent>] <File Path>"
+
+/* Command line options
+* Optional flags come before the ROM path :
+*   --shm <name>          : publish every frame into the shared-memory segment /dev/shm/<name>.
+*   --record <file>       : capture presented frames, Y4M for *.y4m, run-length packed raw frames otherwise.
+*   --record-audio <file> : render the sound timer tone into a WAV file, in emulated time.
+*   --headless <frames>   : run the given number of frames without SDL, e.g. to record on a server.
+*   --vsync               : pace frames with a vsync renderer, falling back to the timer when vsync is unusable.
+*   --grid <cols>x<rows>  : run cols * rows differently seeded instances of the ROM in one window.
+*   --keymap <file>       : replace the default keyboard and gamepad bindings, see assets/keymap.cfg.
+*   --run-ahead <frames>  : show the screen the given number of frames ahead with the keys held now, against input lag.
+*   --netplay <transport> : play together with a second emulator using rollback, through
+*                           udp:<local port>:<remote host>:<remote port> or unix:<local path>:<remote path>.
+*   --net-latency <ms>, --net-jitter <ms>, --net-loss <percent> : degrade what netplay sends, to try it over loopback.
+*/
+struct Options
+{
+    std::string shm_name;
+    std::string record_path;
+    std::string audio_path;
+    unsigned long headless_frames = 0;
+    bool vsync = false;
+    unsigned int grid_cols = 0;
+    unsigned int grid_rows = 0;
+    std::string keymap_path;
+    unsigned int run_ahead = 0;
+    std::string netplay_spec;
+    unsigned int net_latency = 0;
+    unsigned int net_jitter = 0;
+    double net_loss = 0.0;
+};
+
+static int ParseOptions(int argc, char* argv[], Options& options)
+{
+    int arg = 1;
+
+    while (arg < argc && strncmp(argv[arg], "--", 2) == 0)
+    {
+        std::string flag = argv[arg++];
+
+        // Flags without a value.
+        if (flag == "--vsync")
+        {
+            options.vsync = true;
+            continue;
+        }
+
+        if (arg >= argc)
+        {
+            std::cout << "Missing value for option " << flag << std::endl;
+            exit(1);
+        }
+
+        if (flag == "--shm")
+            options.shm_name = argv[arg++];
+        else if (flag == "--record")
+            options.record_path = argv[arg++];
+        else if (flag == "--record-audio")
+            options.audio_path = argv[arg++];
+        else if (flag == "--headless")
+            options.headless_frames = strtoul(argv[arg++], nullptr, 10);
+        else if (flag == "--run-ahead")
+        {
+            options.run_ahead = static_cast<unsigned int>(strtoul(argv[arg++], nullptr, 10));
+            if (options.run_ahead == 0 || options.run_ahead > RUNAHEAD_MAX_FRAMES)
+            {
+                std::cout << "Run-ahead must be 1 to " << RUNAHEAD_MAX_FRAMES << " frames" << std::endl;
+                exit(1);
+            }
+        }
+        else if (flag == "--netplay")
+            options.netplay_spec = argv[arg++];
+        else if (flag == "--net-latency")
+            options.net_latency = static_cast<unsigned int>(strtoul(argv[arg++], nullptr, 10));
+        else if (flag == "--net-jitter")
+            options.net_jitter = static_cast<unsigned int>(strtoul(argv[arg++], nullptr, 10));
+        else if (flag == "--net-loss")
+            options.net_loss = strtod(argv[arg++], nullptr) / 100.0;
+        else if (flag == "--keymap")
+            options.keymap_path = argv[arg++];
+        else if (flag == "--grid")
+        {
+            if (sscanf(argv[arg++], "%ux%u", &options.grid_cols, &options.grid_rows) != 2 ||
+                options.grid_cols == 0 || options.grid_rows == 0)
+            {
+                std::cout << "Grid must look like 4x3" << std::endl;
+                exit(1);
+            }
+        }
+        else
+        {
+            std::cout << "Unknown option " << flag << std::endl;
+            exit(1);
+        }
+    }
+
+    // Frames are only final once the peer's input arrived, per-cycle capture and prediction have nothing stable to work on.
+    if (!options.netplay_spec.empty() &&
+        (!options.record_path.empty() || !options.audio_path.empty() || options.grid_cols > 0 || options.run_ahead > 0))
+    {
+        std::cout << "--netplay cannot be combined with --record, --record-audio, --grid or --run-ahead" << std::endl;
+        exit(1);
+    }
+
+    return arg;
+}
+
+// Monitor many instances : a VecEnv steps all of them once per 60 Hz frame on worker threads,
+// and every instance is one tile of a GridWindow. The keyboard drives all instances at once.
+static void RunGrid(const char* file, unsigned int cols, unsigned int rows, const std::string& keymap)
+{
+    VecEnv env(cols * rows);
+    CHIP8Fault loaded = env.Load(file);
+    if (loaded != CHIP8Fault::NONE)
+    {
+        printf("File Error: Cannot load the game at %s (%s)\n", file, CHIP8::FaultName(loaded));
+        exit(-1);
+    }
+
+    GridWindow grid("CHIP8 Grid", cols, rows);
+    EventHandler eventHandler;
+    if (!keymap.empty() && !eventHandler.LoadKeymap(keymap))
+        exit(1);
+
+    std::vector<uint16_t> actions(env.Size());
+    std::vector<uint8_t> screens(env.Size() * env.ObsSize());
+    std::vector<CHIP8Fault> faults(env.Size());
+    std::vector<bool> reported(env.Size(), false);
+
+    auto frame = std::chrono::microseconds(16667);
+    auto next = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        eventHandler.HandleEvent();
+        std::fill(actions.begin(), actions.end(), eventHandler.Keys());
+
+        env.Step(actions.data(), screens.data(), faults.data());
+
+        for (unsigned int i = 0; i < env.Size(); i++)
+        {
+            // A faulted instance keeps its last screen, the others go on.
+            if (faults[i] != CHIP8Fault::NONE && !reported[i])
+            {
+                printf("CPU Error: instance %u stopped (%s)\n", i, CHIP8::FaultName(faults[i]));
+                reported[i] = true;
+            }
+
+            grid.Update(i, screens.data() + i * env.ObsSize(), env.Instance(i).TakeDirtyRows());
+        }
+        grid.Present();
+
+        next += frame;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+// Exit with the first fault of chip8, if any.
+static void CheckFault(const CHIP8& chip8)
+{
+    const CHIP8FaultInfo& info = chip8.Fault();
+    if (info.fault != CHIP8Fault::NONE)
+    {
+        std::cout << "CPU Error: " << CHIP8::FaultName(info.fault) << " at " << std::hex << info.pc
+                  << ", opcode " << info.opcode << std::dec << "." << std::endl;
+        exit(3);
+    }
+}
+
+static void PrintNetplay(const NetplaySession& session)
+{
+    printf("Netplay: frame %llu, %llu rollbacks, %llu frames re-run, %llu stalls\n",
+        static_cast<unsigned long long>(session.Frame()), static_cast<unsigned long long>(session.Rollbacks()),
+        static_cast<unsigned long long>(session.ResimulatedFrames()), static_cast<unsigned long long>(session.Stalls()));
+}
+
+// Headless netplay against a peer with scripted keys, e.g. two processes on one host over loopback.
+// Each side derives its keys from its own transport spec, so the two press different keys.
+// Print the final state hash, which has to be the same on both sides.
+static void RunNetplayHeadless(CHIP8& chip8, NetTransport& transport, const std::string& spec, unsigned long frames)
+{
+    NetplaySession session(chip8, transport);
+
+    uint32_t salt = 2166136261u;
+    for (char c : spec)
+        salt = (salt ^ static_cast<uint8_t>(c)) * 16777619u;
+
+    while (session.Frame() < frames)
+    {
+        // Hold one key for 8 frames out of every 24.
+        uint32_t step = static_cast<uint32_t>(session.Frame() / 8) + salt;
+        uint16_t keys = step % 3 == 0 ? static_cast<uint16_t>(1u << ((step / 3) & 0xF)) : 0;
+
+        if (!session.AdvanceFrame(keys))
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        CheckFault(chip8);
+    }
+
+    while (!session.Settled())
+    {
+        session.Poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto linger = std::chrono::steady_clock::now() + std::chrono::milliseconds(NETPLAY_LINGER_MS);
+    while (std::chrono::steady_clock::now() < linger)
+    {
+        session.Poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    PrintNetplay(session);
+    printf("Netplay: state %016llx%s\n", static_cast<unsigned long long>(chip8.Hash()), session.Desynced() ? ", DESYNC" : "");
+    exit(session.Desynced() ? 4 : 0);
+}
+
+// Interactive netplay. Frames run on a 60 Hz clock, a frame is skipped while the peer is too far behind.
+static void RunNetplay(CHIP8& chip8, NetTransport& transport, const Options& options, SharedFramePublisher* publisher)
+{
+    Window window("CHIP8 Netplay", 1024, 512);
+    window.Connect(&chip8);
+
+    // Not connected : the session decides which keys the machine sees on every frame.
+    EventHandler eventHandler;
+    if (!options.keymap_path.empty() && !eventHandler.LoadKeymap(options.keymap_path))
+        exit(1);
+
+    AudioPlayer audioPlayer("../assets/beep.wav");
+    audioPlayer.Connect(&chip8);
+
+    NetplaySession session(chip8, transport);
+    bool reported = false;
+
+    auto frame = std::chrono::microseconds(16667);
+    auto next = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        eventHandler.HandleEvent();
+
+        if (session.AdvanceFrame(eventHandler.Keys()))
+        {
+            CheckFault(chip8);
+            window.DrawFrame();
+            window.Present();
+            audioPlayer.Beep();
+
+            if (publisher != nullptr)
+                publisher->Publish(chip8, session.Frame());
+        }
+
+        if (session.Desynced() && !reported)
+        {
+            printf("Netplay Error: the machines diverged, both sides have to run the same ROM.\n");
+            PrintNetplay(session);
+            reported = true;
+        }
+
+        next += frame;
+        std::this_thread::sleep_until(next);
+    }
+}
 
 int main(int argc, char* argv[])
 {
     char file[100];
 
+    Options options;
+    int arg = ParseOptions(argc, argv, options);
+
 #ifdef _WIN64
     // In windows system, use Windows File System API to select file.
     OPENFILENAMEA ofn;
@@ -30,19 +311,132 @@ int main(int argc, char* argv[])
 
 #elif __linux__
     // In linux system, use command line to select file.
-    if (argc != 2)
+    if (argc != arg + 1 || strlen(argv[arg]) >= sizeof(file))
     {
-        std::cout << "Usage : ./CHIP8-Emulator <File Path>" << std::endl;
+        std::cout << USAGE << std::endl;
         exit(1);
     }
 
-    strcpy(file, argv[1]);
+    strcpy(file, argv[arg]);
 #else
     // Unsupport platform.
     std::cout << "Unsupport Platform" << std::endl;
     exit(1);
 #endif
 
+    // Static, so the segment is unlinked and the recording is flushed by the exit() calls of the event handler too.
+    static std::unique_ptr<SharedFramePublisher> publisher;
+    static std::unique_ptr<FrameRecorder> recorder;
+    static std::unique_ptr<AudioRecorder> audio;
+
+    if (!options.shm_name.empty())
+    {
+        publisher = std::make_unique<SharedFramePublisher>(options.shm_name);
+        if (!publisher->IsOpen())
+        {
+            printf("Shared Memory Error: Cannot create segment %s\n", options.shm_name.c_str());
+            exit(1);
+        }
+    }
+
+    if (!options.record_path.empty())
+    {
+        recorder = std::make_unique<FrameRecorder>(options.record_path, FrameRecorder::FormatFromPath(options.record_path));
+        if (!recorder->IsOpen())
+        {
+            printf("Record Error: Cannot open %s\n", options.record_path.c_str());
+            exit(1);
+        }
+
+        // Runs before the recorder is destroyed, the drop count is final by then.
+        std::atexit([]() {
+            if (recorder != nullptr && recorder->Dropped() > 0)
+                printf("Record: %llu frames dropped\n", static_cast<unsigned long long>(recorder->Dropped()));
+        });
+    }
+
+    if (!options.audio_path.empty())
+    {
+        audio = std::make_unique<AudioRecorder>(options.audio_path);
+        if (!audio->IsOpen())
+        {
+            printf("Record Error: Cannot open %s\n", options.audio_path.c_str());
+            exit(1);
+        }
+
+        std::atexit([]() {
+            if (audio != nullptr && audio->Dropped() > 0)
+                printf("Record: %llu audio segments dropped\n", static_cast<unsigned long long>(audio->Dropped()));
+        });
+    }
+
+    CHIP8 chip8;
+
+    CHIP8Fault loaded = chip8.Load(file);
+    if (loaded != CHIP8Fault::NONE)
+    {
+        printf("File Error: Cannot load the game at %s (%s)\n", file, CHIP8::FaultName(loaded));
+        exit(-1);
+    }
+
+    // Static, so a Unix socket path is unlinked by exit() too.
+    static std::unique_ptr<SocketTransport> socket;
+    static std::unique_ptr<LossyTransport> lossy;
+    NetTransport* transport = nullptr;
+
+    if (!options.netplay_spec.empty())
+    {
+        socket = std::make_unique<SocketTransport>(options.netplay_spec);
+        if (!socket->IsOpen())
+        {
+            printf("Netplay Error: Cannot open %s\n", options.netplay_spec.c_str());
+            exit(1);
+        }
+        transport = socket.get();
+
+        if (options.net_latency > 0 || options.net_jitter > 0 || options.net_loss > 0.0)
+        {
+            lossy = std::make_unique<LossyTransport>(*socket, options.net_latency, options.net_jitter, options.net_loss);
+            transport = lossy.get();
+        }
+
+        if (options.headless_frames > 0)
+            RunNetplayHeadless(chip8, *transport, options.netplay_spec, options.headless_frames);
+    }
+
+    // Headless : no window, audio device or input. Every frame is recorded and published.
+    if (options.headless_frames > 0)
+    {
+        for (unsigned long frame = 1; frame <= options.headless_frames; frame++)
+        {
+            if (audio == nullptr)
+                chip8.RunFrame();
+            else
+            {
+                // Audio is sampled per cycle, so step the frame one cycle at a time.
+                for (unsigned int c = 0; c < CHIP8_CYCLES_PER_FRAME; c++)
+                {
+                    chip8.EmulateCycle();
+                    while (audio->Full())
+                        std::this_thread::yield();
+                    audio->Cycle(chip8);
+                }
+            }
+            CheckFault(chip8);
+
+            if (recorder != nullptr)
+            {
+                // No real-time deadline here, so wait for the writer instead of dropping frames.
+                while (recorder->Full())
+                    std::this_thread::yield();
+                recorder->Push(chip8.Screen(), frame);
+            }
+            if (publisher != nullptr)
+                publisher->Publish(chip8, frame);
+        }
+        exit(0);
+    }
+
     // Initialize SDL for graphic and audio.
     if (SDL_Init(SDL_INIT_EVERYTHING) < 0)
     {
@@ -50,39 +444,113 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
-    CHIP8 chip8;
+    if (options.grid_cols > 0)
+        RunGrid(file, options.grid_cols, options.grid_rows, options.keymap_path);
+
+    if (transport != nullptr)
+        RunNetplay(chip8, *transport, options, publisher.get());
 
     int w = 1024;
     int h = 512;
 
-    Window window("CHIP8 Game", w, h);
+    Window window("CHIP8 Game", w, h, options.vsync);
     window.Connect(&chip8);
+    window.Record(recorder.get());
+
+    static std::unique_ptr<RunAhead> runAhead;
+    if (options.run_ahead > 0)
+    {
+        runAhead = std::make_unique<RunAhead>(options.run_ahead);
+        window.Predict(runAhead.get());
+
+        std::atexit([]() {
+            printf("Run-ahead: %u frames, %.1f us per frame over %llu frames\n", runAhead->FramesAhead(),
+                runAhead->OverheadMicroseconds(), static_cast<unsigned long long>(runAhead->Predictions()));
+        });
+    }
 
     EventHandler eventHandler;
     eventHandler.Connect(&chip8);
+    if (!options.keymap_path.empty() && !eventHandler.LoadKeymap(options.keymap_path))
+        exit(1);
 
     AudioPlayer audioPlayer("../assets/beep.wav");
     audioPlayer.Connect(&chip8);
 
-    chip8.Load(file);
+    FramePacer pacer(options.vsync ? FramePacer::PACE_VSYNC : FramePacer::PACE_TIMER, window.RefreshRate());
+    if (options.vsync && !pacer.Calibrate(window))
+        window.DisableVSync();
 
-    while (true)
-    {
-        auto start = std::chrono::high_resolution_clock::now();
+    uint64_t cycle = 0;
 
+    // Everything which happens once per emulated cycle, whichever way the cycles are paced.
+    auto step = [&]() {
         chip8.EmulateCycle();
+        CheckFault(chip8);
+        if (audio != nullptr)
+            audio->Cycle(chip8);
         eventHandler.HandleEvent();
         window.Draw();
         audioPlayer.Beep();
 
-        auto elapsed = std::chrono::high_resolution_clock::now() - start;
+        // Publish once per 60 Hz frame, the publisher never waits on readers.
+        if (publisher != nullptr && ++cycle % CHIP8_CYCLES_PER_FRAME == 0)
+            publisher->Publish(chip8, cycle / CHIP8_CYCLES_PER_FRAME);
+    };
+
+    // Skipping the idle cycles would shorten captures, which follow emulated time.
+    bool idle_wait = recorder == nullptr && audio == nullptr;
+    bool idle = false;
+
+    while (true)
+    {
+        // FX0A with nothing held and the timers stopped : the coming cycles change nothing,
+        // so sleep on the event queue instead of spinning through them.
+        if (idle_wait && chip8.WaitingForKey())
+        {
+            // Sprites drawn earlier in this frame wait for a frame boundary which is not coming, so show them now.
+            if (!idle)
+            {
+                window.DrawFrame();
+                if (publisher != nullptr)
+                    publisher->Publish(chip8, cycle / CHIP8_CYCLES_PER_FRAME);
+                idle = true;
+            }
+
+            window.Present();
+            eventHandler.WaitEvent(IDLE_WAIT_MS);
+            pacer.Resync();
+            continue;
+        }
+        idle = false;
+
+        if (pacer.GetMode() == FramePacer::PACE_TIMER)
+        {
+            auto start = FramePacer::clock::now();
+
+            step();
+            // Only presents on frame boundaries which changed the screen.
+            window.Present();
+
+            pacer.WaitCycle(start);
+            continue;
+        }
+
+        // Vsync : run the frames which are due, then present once. The present blocks until vertical blank.
+        unsigned int frames = pacer.FramesDue();
+        if (frames == 0)
+        {
+            pacer.WaitNextFrame();
+            continue;
+        }
 
-        long long delt_t = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        for (unsigned int c = 0; c < frames * CHIP8_CYCLES_PER_FRAME; c++)
+            step();
 
-        // Since the timer counts in 60 Hz, put thread holds for 0.013ms each cycle.
-        if (delt_t < CHIP8_MICROSECOND_PER_CYCLE)
-            std::this_thread::sleep_for(std::chrono::microseconds(CHIP8_MICROSECOND_PER_CYCLE - delt_t));
+        auto before = FramePacer::clock::now();
+        if (window.Present() && !pacer.Presented(before, FramePacer::clock::now()))
+            window.DisableVSync();
     }
 
     return 0;
-}
\ No newline at end of file
+}
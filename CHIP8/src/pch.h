@@ -1,14 +1,19 @@
 #pragma once
 
+#include <algorithm>
+#include <cctype>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <memory>
 #include <bitset>
 #include <thread>
 #include <stdlib.h>
 #include <queue>
+#include <vector>
 
 #ifdef _WIN64
 #include <Windows.h>
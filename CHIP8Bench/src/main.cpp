@@ -0,0 +1,389 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CHIP8.h"
+#include "CHIP8Pool.h"
+#include "FramebufferConverter.h"
+#include "RomCache.h"
+#include "RunAhead.h"
+#include "VecEnv.h"
+
+/* Benchmark suite
+* Runs every ROM in the ROM directory headlessly as fast as possible and reports
+* the emulated cycles per second. The keys are toggled on a fixed pattern
+* so that ROMs waiting for input keep executing game code instead of idling.
+*
+* Usage : ./CHIP8Bench [--frames N] [--train] [rom dir]
+*
+*   --train : only run the ROMs, without the load / reset / clone / VecEnv / framebuffer / run-ahead
+*             sections. Used as the ReleasePGO training run, so the profiles describe emulation only.
+*/
+
+#define BENCH_SEED 0xC8C8C8C8u
+#define BENCH_DEFAULT_FRAMES 200000
+#define BENCH_CLONE_ROUNDS 100000
+#define BENCH_VECENV_SIZE 256
+#define BENCH_VECENV_STEPS 2000
+#define BENCH_FRAMEBUFFER_PIXELS 2e9
+#define BENCH_RUNAHEAD_FRAMES 20000
+#define BENCH_LOAD_ROUNDS 200000
+#define BENCH_RESET_ROUNDS 2000000
+
+static std::vector<std::string> ListRoms(const std::string& dir)
+{
+    std::vector<std::string> roms;
+
+    std::error_code error;
+    if (!std::filesystem::is_directory(dir, error))
+    {
+        printf("Bench Error: Cannot open the ROM directory %s\n", dir.c_str());
+        exit(1);
+    }
+
+    for (const auto& entry : std::filesystem::directory_iterator(dir, error))
+        if (entry.is_regular_file())
+            roms.push_back(entry.path().filename().string());
+
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+// Run one ROM and return the elapsed time in seconds.
+static double RunRom(const std::string& path, unsigned int frames)
+{
+    CHIP8 chip8;
+    if (chip8.Load(path) != CHIP8Fault::NONE)
+    {
+        printf("Bench Error: Cannot load %s\n", path.c_str());
+        exit(1);
+    }
+    chip8.Seed(BENCH_SEED);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned int frame = 0; frame < frames; frame++)
+    {
+        // Hold one key for 16 frames, then move on to the next one.
+        if ((frame & 0xF) == 0)
+        {
+            uint8_t k = static_cast<uint8_t>(frame >> 4);
+            chip8.SetKey((k - 1) & 0xF, 0);
+            chip8.SetKey(k & 0xF, 1);
+        }
+
+        if (chip8.RunFrame().fault != CHIP8Fault::NONE)
+        {
+            printf("Bench Error: %s faulted (%s)\n", path.c_str(), CHIP8::FaultName(chip8.Fault().fault));
+            exit(1);
+        }
+    }
+
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    return std::chrono::duration<double>(elapsed).count();
+}
+
+// Measure CHIP8::Clone() the way a tree search uses it :
+// fork one branch per key from the same state, then give all of them back.
+static void BenchClone(const std::string& path)
+{
+    CHIP8 root;
+    root.Load(path);
+    root.Seed(BENCH_SEED);
+    for (unsigned int frame = 0; frame < 120; frame++)
+        root.RunFrame();
+
+    CHIP8Pool pool(CHIP8_KEY_SIZE);
+    CHIP8* branches[CHIP8_KEY_SIZE];
+    uint64_t checksum = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned int round = 0; round < BENCH_CLONE_ROUNDS; round++)
+    {
+        for (uint8_t k = 0; k < CHIP8_KEY_SIZE; k++)
+        {
+            branches[k] = root.Clone(pool);
+            branches[k]->SetKey(k, 1);
+        }
+        checksum += branches[round & 0xF]->Screen()[round & 0x7FF];
+        pool.ReleaseAll();
+    }
+
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double clones = static_cast<double>(BENCH_CLONE_ROUNDS) * CHIP8_KEY_SIZE;
+
+    printf("Clone: %.1f ns/clone, %.2f M clones/s (checksum %llu)\n",
+        seconds / clones * 1e9, clones / seconds / 1e6, static_cast<unsigned long long>(checksum));
+}
+
+// Measure reloading the same ROM, the way batch runs restart from the file.
+static void BenchLoad(const std::string& path)
+{
+    CHIP8 chip8;
+    uint64_t misses = RomCache::Instance().Misses();
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned int round = 0; round < BENCH_LOAD_ROUNDS; round++)
+        chip8.Load(path);
+
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+
+    printf("Load: %.0f ns/load, %.2f M loads/s (%llu file reads, %zu cached images)\n",
+        seconds / BENCH_LOAD_ROUNDS * 1e9, BENCH_LOAD_ROUNDS / seconds / 1e6,
+        static_cast<unsigned long long>(RomCache::Instance().Misses() - misses), RomCache::Instance().Images());
+}
+
+// Measure episode restarts : a few frames of play, then back to the power-on state.
+static void BenchReset(const std::string& path)
+{
+    CHIP8 chip8;
+    chip8.Load(path);
+    chip8.Seed(BENCH_SEED);
+    uint64_t expected = chip8.Hash();
+
+    chip8.RunFrame();
+    chip8.Seed(BENCH_SEED);
+    chip8.Reset();
+    if (chip8.Hash() != expected)
+    {
+        printf("Bench Error: Reset() does not restore the power-on state of %s\n", path.c_str());
+        exit(1);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned int round = 0; round < BENCH_RESET_ROUNDS; round++)
+    {
+        chip8.Reset();
+        chip8.SetKey(round & 0xF, 1);
+    }
+
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+
+    printf("Reset: %.1f ns/reset, %.2f M resets/s\n",
+        seconds / BENCH_RESET_ROUNDS * 1e9, BENCH_RESET_ROUNDS / seconds / 1e6);
+}
+
+// Measure batched stepping with bit-packed observations, the layout RL trainers consume.
+static void BenchVecEnv(const std::string& path)
+{
+    VecEnv env(BENCH_VECENV_SIZE, 4, 0, VecEnv::OBS_PACKED);
+    env.Load(path, BENCH_SEED);
+
+    std::vector<uint16_t> actions(env.Size());
+    std::vector<uint8_t> obs(env.Size() * env.ObsSize());
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (unsigned int step = 0; step < BENCH_VECENV_STEPS; step++)
+    {
+        for (unsigned int i = 0; i < env.Size(); i++)
+            actions[i] = static_cast<uint16_t>(1u << ((step / 8 + i) & 0xF));
+        env.Step(actions.data(), obs.data());
+    }
+
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double frames = static_cast<double>(BENCH_VECENV_STEPS) * env.Size() * 4;
+
+    printf("VecEnv: %u envs, %.2f M frames/s\n", env.Size(), frames / seconds / 1e6);
+}
+
+// Measure the ARGB conversion of every kernel the CPU supports at every scale,
+// after checking that each one matches the scalar kernel pixel for pixel.
+static bool BenchFramebuffer(const std::string& path)
+{
+    CHIP8 chip8;
+    chip8.Load(path);
+    chip8.Seed(BENCH_SEED);
+    for (unsigned int frame = 0; frame < 300; frame++)
+        chip8.RunFrame();
+
+    const uint8_t* screen = chip8.Screen();
+    uint8_t packed[CHIP8_SCREEN_HEIGHT * FRAMEBUFFER_PACKED_PITCH];
+    for (unsigned int b = 0; b < sizeof(packed); b++)
+    {
+        packed[b] = 0;
+        for (unsigned int p = 0; p < 8; p++)
+            packed[b] |= static_cast<uint8_t>((screen[b * 8 + p] ? 1 : 0) << (7 - p));
+    }
+
+    const size_t max_pixels = static_cast<size_t>(CHIP8_SCREEN_WIDTH) * CHIP8_SCREEN_HEIGHT * FRAMEBUFFER_MAX_SCALE * FRAMEBUFFER_MAX_SCALE;
+    std::vector<uint32_t> expected(max_pixels), out(max_pixels);
+    const FramebufferConverter::Kernel kernels[] =
+        { FramebufferConverter::KERNEL_SCALAR, FramebufferConverter::KERNEL_SSE2, FramebufferConverter::KERNEL_AVX2 };
+    bool ok = true;
+
+    for (unsigned int scale = 1; scale <= FRAMEBUFFER_MAX_SCALE; scale *= 2)
+    {
+        int pitch = static_cast<int>(CHIP8_SCREEN_WIDTH * scale * sizeof(uint32_t));
+        size_t pixels = static_cast<size_t>(CHIP8_SCREEN_WIDTH) * CHIP8_SCREEN_HEIGHT * scale * scale;
+        unsigned int rounds = static_cast<unsigned int>(BENCH_FRAMEBUFFER_PIXELS / 4 / pixels) + 1;
+
+        FramebufferConverter reference(0xFF102030, 0xFFE0D0C0, scale, FramebufferConverter::KERNEL_SCALAR);
+        reference.ConvertBytes(screen, 0, CHIP8_SCREEN_HEIGHT, expected.data(), pitch);
+
+        printf("Framebuffer x%-2u", scale);
+
+        for (FramebufferConverter::Kernel kernel : kernels)
+        {
+            if (!FramebufferConverter::Supported(kernel))
+                continue;
+
+            FramebufferConverter converter(0xFF102030, 0xFFE0D0C0, scale, kernel);
+
+            for (int source = 0; source < 2; source++)
+            {
+                memset(out.data(), 0, pixels * sizeof(uint32_t));
+                if (source == 0)
+                    converter.ConvertBytes(screen, 0, CHIP8_SCREEN_HEIGHT, out.data(), pitch);
+                else
+                    converter.ConvertPacked(packed, 0, CHIP8_SCREEN_HEIGHT, out.data(), pitch);
+
+                if (memcmp(out.data(), expected.data(), pixels * sizeof(uint32_t)) != 0)
+                {
+                    printf("\nBench Error: %s %s kernel differs from scalar at x%u\n",
+                        FramebufferConverter::KernelName(kernel), source == 0 ? "bytes" : "packed", scale);
+                    ok = false;
+                }
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (unsigned int round = 0; round < rounds; round++)
+                converter.ConvertBytes(screen, 0, CHIP8_SCREEN_HEIGHT, out.data(), pitch);
+            auto elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            double seconds = std::chrono::duration<double>(elapsed).count();
+            printf("  %-6s %8.0f Mpixels/s", FramebufferConverter::KernelName(kernel), rounds * pixels / seconds / 1e6);
+        }
+        printf("\n");
+    }
+
+    return ok;
+}
+
+// Measure the per-frame cost of run-ahead at every depth, after checking on every frame
+// that the machine is rolled back untouched and the prediction matches the real future.
+static bool BenchRunAhead(const std::string& path)
+{
+    for (unsigned int ahead = 1; ahead <= 4; ahead++)
+    {
+        CHIP8 chip8, future;
+        chip8.Load(path);
+        chip8.Seed(BENCH_SEED);
+
+        RunAhead runAhead(ahead);
+
+        for (unsigned int frame = 0; frame < BENCH_RUNAHEAD_FRAMES; frame++)
+        {
+            // Same key pattern as RunRom().
+            if ((frame & 0xF) == 0)
+            {
+                uint8_t k = static_cast<uint8_t>(frame >> 4);
+                chip8.SetKey((k - 1) & 0xF, 0);
+                chip8.SetKey(k & 0xF, 1);
+            }
+            chip8.RunFrame();
+
+            uint64_t hash = chip8.Hash();
+            runAhead.Predict(chip8);
+
+            // Checking every frame would dominate the timing, a sample is enough.
+            if ((frame & 0xFF) != 0)
+                continue;
+
+            future = chip8;
+            for (unsigned int f = 0; f < ahead; f++)
+                future.RunFrame();
+
+            if (chip8.Hash() != hash || memcmp(future.Screen(), runAhead.Screen(), CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT) != 0)
+            {
+                printf("Bench Error: run-ahead %u frames diverged at frame %u\n", ahead, frame);
+                return false;
+            }
+        }
+
+        printf("RunAhead %u: %.2f us/frame\n", ahead, runAhead.OverheadMicroseconds());
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int frames = BENCH_DEFAULT_FRAMES;
+    bool train = false;
+    std::string rom_dir = "../rom";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+        else if (strcmp(argv[i], "--train") == 0)
+            train = true;
+        else if (argv[i][0] != '-')
+            rom_dir = argv[i];
+        else
+        {
+            // --help included : anything else which looks like an option.
+            printf("Usage : ./CHIP8Bench [--frames N] [--train] [rom dir]\n");
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    std::vector<std::string> roms = ListRoms(rom_dir);
+    // Nothing would run : no total to report, and --train would leave empty profiles.
+    if (frames == 0)
+    {
+        printf("Bench Error: --frames must be at least 1\n");
+        return 1;
+    }
+    if (roms.empty())
+    {
+        printf("Bench Error: No ROM in %s\n", rom_dir.c_str());
+        return 1;
+    }
+
+    double total_seconds = 0.0;
+    double total_cycles = 0.0;
+
+    for (const std::string& rom : roms)
+    {
+        double seconds = RunRom(rom_dir + "/" + rom, frames);
+        double cycles = static_cast<double>(frames) * CHIP8_CYCLES_PER_FRAME;
+
+        printf("%-10s %10.2f Mcycles/s %10.0f frames/s\n",
+            rom.c_str(), cycles / seconds / 1e6, frames / seconds);
+
+        total_seconds += seconds;
+        total_cycles += cycles;
+    }
+
+    // This line is parsed by scripts/pgo.sh.
+    printf("Bench: total %.2f Mcycles/s\n", total_cycles / total_seconds / 1e6);
+
+    if (!train)
+    {
+        BenchLoad(rom_dir + "/" + roms[0]);
+        BenchReset(rom_dir + "/" + roms[0]);
+        BenchClone(rom_dir + "/" + roms[0]);
+        BenchVecEnv(rom_dir + "/" + roms[0]);
+        if (!BenchFramebuffer(rom_dir + "/" + roms[0]))
+            return 1;
+        if (!BenchRunAhead(rom_dir + "/" + roms[0]))
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "CHIP8C.h"
+
+#include <memory>
+#include <new>
+
+#include "CHIP8.h"
+#include "VecEnv.h"
+
+// A machine handle points at either its own instance or one owned by a chip8_vec.
+// The core does not cache ROM bytes, so the handle also keeps the machine chip8_reset returns to.
+struct chip8_machine
+{
+    CHIP8* chip8 = nullptr;
+    std::unique_ptr<CHIP8> owned;
+    std::unique_ptr<CHIP8> reset_image;
+};
+
+struct chip8_vec
+{
+    chip8_vec(uint32_t n, uint32_t frame_skip, uint32_t threads, VecEnv::ObsFormat format) : env(n, frame_skip, threads, format) {}
+
+    VecEnv env;
+    std::unique_ptr<chip8_machine[]> machines;
+};
+
+static CHIP8* M(chip8_machine* m) { return m->chip8; }
+static const CHIP8* M(const chip8_machine* m) { return m->chip8; }
+static VecEnv* V(chip8_vec* v) { return &v->env; }
+static const VecEnv* V(const chip8_vec* v) { return &v->env; }
+
+static_assert(sizeof(CHIP8Fault) == 1, "C ABI passes faults as uint8_t");
+static_assert(static_cast<uint8_t>(CHIP8Fault::MEMORY_OVERRUN) == CHIP8C_FAULT_MEMORY_OVERRUN, "C ABI fault codes");
+static_assert(sizeof(CHIP8FaultInfo) == sizeof(chip8_fault_info), "C ABI fault info layout");
+
+static chip8_fault_info ToC(const CHIP8FaultInfo& info)
+{
+    return { static_cast<uint8_t>(info.fault), info.pc, info.opcode };
+}
+
+uint32_t chip8_abi_version(void)
+{
+    return CHIP8C_ABI_VERSION;
+}
+
+const char* chip8_fault_name(uint8_t fault)
+{
+    if (fault == CHIP8C_FAULT_BAD_SNAPSHOT)
+        return "bad snapshot";
+    if (fault == CHIP8C_FAULT_OUT_OF_MEMORY)
+        return "out of memory";
+    return CHIP8::FaultName(static_cast<CHIP8Fault>(fault));
+}
+
+chip8_machine* chip8_create(uint32_t seed)
+{
+    chip8_machine* m = new (std::nothrow) chip8_machine();
+    if (m == nullptr)
+        return nullptr;
+
+    m->owned.reset(new (std::nothrow) CHIP8());
+    if (m->owned == nullptr)
+    {
+        delete m;
+        return nullptr;
+    }
+    m->chip8 = m->owned.get();
+    m->chip8->Seed(seed);
+    return m;
+}
+
+void chip8_destroy(chip8_machine* m)
+{
+    delete m;
+}
+
+void chip8_seed(chip8_machine* m, uint32_t seed)
+{
+    M(m)->Seed(seed);
+}
+
+uint8_t chip8_load_rom(chip8_machine* m, const uint8_t* data, size_t size)
+{
+    // Allocated on the first load, before touching the machine, and overwritten in place by a reload.
+    if (m->reset_image == nullptr)
+    {
+        m->reset_image.reset(new (std::nothrow) CHIP8());
+        if (m->reset_image == nullptr)
+            return CHIP8C_FAULT_OUT_OF_MEMORY;
+    }
+
+    CHIP8Fault fault = M(m)->LoadBytes(data, size);
+    if (fault != CHIP8Fault::NONE)
+        return static_cast<uint8_t>(fault);
+
+    M(m)->KeepResetImage(*m->reset_image);
+    return CHIP8C_FAULT_NONE;
+}
+
+void chip8_reset(chip8_machine* m)
+{
+    M(m)->Reset();
+}
+
+chip8_fault_info chip8_step(chip8_machine* m, uint32_t frames)
+{
+    CHIP8FaultInfo info = M(m)->Fault();
+    for (uint32_t f = 0; f < frames; f++)
+        info = M(m)->RunFrame();
+    return ToC(info);
+}
+
+void chip8_set_keys(chip8_machine* m, uint16_t mask)
+{
+    for (uint8_t k = 0; k < CHIP8_KEY_SIZE; k++)
+        M(m)->SetKey(k, (mask >> k) & 0x1);
+}
+
+const uint8_t* chip8_screen(const chip8_machine* m)
+{
+    return M(m)->Screen();
+}
+
+size_t chip8_snapshot_size(void)
+{
+    return sizeof(CHIP8State);
+}
+
+void chip8_snapshot(const chip8_machine* m, void* out)
+{
+    M(m)->Snapshot(*static_cast<CHIP8State*>(out));
+}
+
+uint8_t chip8_restore(chip8_machine* m, const void* in)
+{
+    return M(m)->Restore(*static_cast<const CHIP8State*>(in)) ? CHIP8C_FAULT_NONE : CHIP8C_FAULT_BAD_SNAPSHOT;
+}
+
+chip8_vec* chip8_vec_create(uint32_t n, uint32_t frame_skip, uint32_t threads, uint8_t obs_format)
+{
+    if (obs_format > CHIP8C_OBS_PACKED)
+        return nullptr;
+    chip8_vec* v = new (std::nothrow) chip8_vec(n, frame_skip, threads, static_cast<VecEnv::ObsFormat>(obs_format));
+    if (v == nullptr)
+        return nullptr;
+
+    v->machines.reset(new (std::nothrow) chip8_machine[n]);
+    if (v->machines == nullptr)
+    {
+        delete v;
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < n; i++)
+        v->machines[i].chip8 = &v->env.Instance(i);
+    return v;
+}
+
+void chip8_vec_destroy(chip8_vec* v)
+{
+    delete v;
+}
+
+uint8_t chip8_vec_load_rom(chip8_vec* v, const uint8_t* data, size_t size, uint32_t seed)
+{
+    return static_cast<uint8_t>(V(v)->LoadBytes(data, size, seed));
+}
+
+uint32_t chip8_vec_size(const chip8_vec* v)
+{
+    return V(v)->Size();
+}
+
+size_t chip8_vec_obs_size(const chip8_vec* v)
+{
+    return V(v)->ObsSize();
+}
+
+void chip8_vec_step(chip8_vec* v, const uint16_t* actions, uint8_t* obs, uint8_t* faults)
+{
+    V(v)->Step(actions, obs, reinterpret_cast<CHIP8Fault*>(faults));
+}
+
+void chip8_vec_reset(chip8_vec* v, const uint8_t* mask, uint8_t* obs)
+{
+    V(v)->Reset(mask, obs);
+}
+
+chip8_machine* chip8_vec_machine(chip8_vec* v, uint32_t i)
+{
+    // Owned by v, must not be passed to chip8_destroy.
+    return &v->machines[i];
+}
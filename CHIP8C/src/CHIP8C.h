@@ -0,0 +1,97 @@
+#pragma once
+
+/* C ABI
+* Stable C interface over CHIP8Core for bindings in other languages.
+* Only opaque handles, fixed-width integers and plain buffers cross this boundary.
+* Any change to an existing signature must bump CHIP8C_ABI_VERSION.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHIP8C_ABI_VERSION 1
+
+#if defined(_WIN32)
+    #if defined(CHIP8C_BUILD)
+        #define CHIP8C_API __declspec(dllexport)
+    #else
+        #define CHIP8C_API __declspec(dllimport)
+    #endif
+#else
+    #define CHIP8C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct chip8_machine chip8_machine;
+typedef struct chip8_vec chip8_vec;
+
+/* Fault codes, same values as CHIP8Fault. */
+enum
+{
+    CHIP8C_FAULT_NONE = 0,
+    CHIP8C_FAULT_UNDEFINED_OPCODE,
+    CHIP8C_FAULT_STACK_OVERFLOW,
+    CHIP8C_FAULT_STACK_UNDERFLOW,
+    CHIP8C_FAULT_ROM_NOT_FOUND,
+    CHIP8C_FAULT_ROM_TOO_LARGE,
+    CHIP8C_FAULT_PC_OUT_OF_RANGE,
+    CHIP8C_FAULT_MEMORY_OVERRUN,
+    CHIP8C_FAULT_BAD_SNAPSHOT = 0x80,
+    CHIP8C_FAULT_OUT_OF_MEMORY
+};
+
+/* Observation formats of chip8_vec, same values as VecEnv::ObsFormat. */
+enum
+{
+    CHIP8C_OBS_BYTES = 0,
+    CHIP8C_OBS_PACKED
+};
+
+typedef struct chip8_fault_info
+{
+    uint8_t fault;
+    uint16_t pc;
+    uint16_t opcode;
+} chip8_fault_info;
+
+CHIP8C_API uint32_t chip8_abi_version(void);
+CHIP8C_API const char* chip8_fault_name(uint8_t fault);
+
+/* Single machine */
+CHIP8C_API chip8_machine* chip8_create(uint32_t seed);
+CHIP8C_API void chip8_destroy(chip8_machine* m);
+// The seed survives chip8_load_rom, reseed here to start a new episode.
+CHIP8C_API void chip8_seed(chip8_machine* m, uint32_t seed);
+// CHIP8C_FAULT_OUT_OF_MEMORY when the copy chip8_reset returns to cannot be allocated, the machine is left untouched.
+CHIP8C_API uint8_t chip8_load_rom(chip8_machine* m, const uint8_t* data, size_t size);
+// Back to the state right after chip8_load_rom, one bulk copy. The seed survives like in chip8_load_rom.
+CHIP8C_API void chip8_reset(chip8_machine* m);
+// Run frames 60 Hz frames and return the fault info after the last one.
+CHIP8C_API chip8_fault_info chip8_step(chip8_machine* m, uint32_t frames);
+// Bit k of mask holds key k.
+CHIP8C_API void chip8_set_keys(chip8_machine* m, uint16_t mask);
+// 64 * 32 bytes, one byte (0 or 1) per pixel. Valid until the machine is destroyed.
+CHIP8C_API const uint8_t* chip8_screen(const chip8_machine* m);
+CHIP8C_API size_t chip8_snapshot_size(void);
+CHIP8C_API void chip8_snapshot(const chip8_machine* m, void* out);
+CHIP8C_API uint8_t chip8_restore(chip8_machine* m, const void* in);
+
+/* Batched machines, see VecEnv.h */
+CHIP8C_API chip8_vec* chip8_vec_create(uint32_t n, uint32_t frame_skip, uint32_t threads, uint8_t obs_format);
+CHIP8C_API void chip8_vec_destroy(chip8_vec* v);
+CHIP8C_API uint8_t chip8_vec_load_rom(chip8_vec* v, const uint8_t* data, size_t size, uint32_t seed);
+CHIP8C_API uint32_t chip8_vec_size(const chip8_vec* v);
+CHIP8C_API size_t chip8_vec_obs_size(const chip8_vec* v);
+// actions : n key masks. obs : n * obs_size bytes. faults : n bytes or NULL.
+CHIP8C_API void chip8_vec_step(chip8_vec* v, const uint16_t* actions, uint8_t* obs, uint8_t* faults);
+// mask : n bytes or NULL for all. obs : n * obs_size bytes.
+CHIP8C_API void chip8_vec_reset(chip8_vec* v, const uint8_t* mask, uint8_t* obs);
+// Instance i, owned by v. Must not be passed to chip8_destroy.
+CHIP8C_API chip8_machine* chip8_vec_machine(chip8_vec* v, uint32_t i);
+
+#ifdef __cplusplus
+}
+#endif
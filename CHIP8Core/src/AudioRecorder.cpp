@@ -0,0 +1,238 @@
+#include "AudioRecorder.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#define AUDIO_FILE_BUFFER (1 << 16)
+// Peak of the square wave, about -12 dBFS.
+#define AUDIO_AMPLITUDE 0x2000
+// Longest segment queued at once, so the file keeps growing during long tones or silences.
+#define AUDIO_MAX_SEGMENT_MS 100
+#define AUDIO_WAV_HEADER_SIZE 44
+
+static void PutU16(FILE* file, uint16_t v)
+{
+    uint8_t b[2] = { static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8) };
+    fwrite(b, 1, sizeof(b), file);
+}
+
+static void PutU32(FILE* file, uint32_t v)
+{
+    uint8_t b[4];
+    for (int i = 0; i < 4; i++)
+        b[i] = static_cast<uint8_t>(v >> (8 * i));
+    fwrite(b, 1, sizeof(b), file);
+}
+
+AudioRecorder::AudioRecorder(const std::string& filepath, unsigned int sample_rate, unsigned int tone_hz, unsigned int capacity)
+    : m_file(nullptr), m_sample_rate(sample_rate ? sample_rate : 44100), m_tone_hz(tone_hz),
+      m_cycles(0), m_samples(0), m_pending{ 0, 0, 0 }, m_lost(0), m_ring(capacity ? capacity : 1),
+      m_head(0), m_tail(0), m_dropped(0), m_written(0), m_stop(false),
+      m_phase(0), m_level(AUDIO_AMPLITUDE)
+{
+    m_file = fopen(filepath.c_str(), "wb");
+    if (m_file == nullptr)
+        return;
+
+    setvbuf(m_file, nullptr, _IOFBF, AUDIO_FILE_BUFFER);
+    // Sizes are unknown until the end, the destructor patches them.
+    _writeHeader(0);
+
+    m_thread = std::thread(&AudioRecorder::_writer, this);
+};
+
+AudioRecorder::~AudioRecorder()
+{
+    if (m_file == nullptr)
+        return;
+
+    // Nothing is real-time any more, so wait for room instead of losing the tail of the recording.
+    while (Full())
+        std::this_thread::yield();
+    _flush();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop.store(true, std::memory_order_release);
+    }
+    m_wake.notify_one();
+    m_thread.join();
+
+    uint64_t data_bytes = m_written.load(std::memory_order_relaxed) * sizeof(int16_t);
+    if (data_bytes > 0xFFFFFFFFull - AUDIO_WAV_HEADER_SIZE)
+        data_bytes = 0xFFFFFFFFull - AUDIO_WAV_HEADER_SIZE;
+
+    fseek(m_file, 0, SEEK_SET);
+    _writeHeader(static_cast<uint32_t>(data_bytes));
+    fclose(m_file);
+};
+
+bool AudioRecorder::IsOpen() const
+{
+    return m_file != nullptr;
+};
+
+void AudioRecorder::Cycle(const CHIP8& chip8)
+{
+    if (m_file == nullptr)
+        return;
+
+    // Sample index at the end of this cycle. Integer math keeps the rounding from drifting over long runs.
+    m_cycles++;
+    uint64_t target = m_cycles * m_sample_rate / (60ull * CHIP8_CYCLES_PER_FRAME);
+    uint32_t count = static_cast<uint32_t>(target - m_samples);
+    m_samples = target;
+
+    uint8_t tone = chip8.sound_timer > 0 ? 1 : 0;
+    if (tone != m_pending.tone || m_pending.samples >= m_sample_rate * AUDIO_MAX_SEGMENT_MS / 1000)
+    {
+        _flush();
+        m_pending.tone = tone;
+    }
+    m_pending.samples += count;
+};
+
+bool AudioRecorder::Full() const
+{
+    return m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire) >= m_ring.size();
+};
+
+uint64_t AudioRecorder::Dropped() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+};
+
+uint64_t AudioRecorder::Written() const
+{
+    return m_written.load(std::memory_order_relaxed);
+};
+
+bool AudioRecorder::_flush()
+{
+    if (m_pending.samples == 0 && m_lost == 0)
+        return true;
+
+    Segment segment = m_pending;
+    m_pending.samples = 0;
+
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= m_ring.size())
+    {
+        // Keep the length, the writer turns it into silence once a segment gets through.
+        m_lost += segment.samples;
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    segment.lost = static_cast<uint32_t>(m_lost < UINT32_MAX ? m_lost : UINT32_MAX);
+    m_lost -= segment.lost;
+
+    m_ring[head % m_ring.size()] = segment;
+    m_head.store(head + 1, std::memory_order_release);
+    // No lock here : a missed wake-up only delays the writer until its next timeout.
+    m_wake.notify_one();
+    return true;
+};
+
+void AudioRecorder::_writer()
+{
+    while (true)
+    {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail == m_head.load(std::memory_order_acquire))
+        {
+            if (m_stop.load(std::memory_order_acquire))
+            {
+                // The producer is gone once stop is set, so one last check drains everything.
+                if (tail == m_head.load(std::memory_order_acquire))
+                    break;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(10));
+            continue;
+        }
+
+        _writeSegment(m_ring[tail % m_ring.size()]);
+        m_tail.store(tail + 1, std::memory_order_release);
+    }
+
+    fflush(m_file);
+};
+
+void AudioRecorder::_writeSegment(const Segment& segment)
+{
+    if (segment.lost > 0)
+        _writeSilence(segment.lost);
+
+    m_block.resize(static_cast<size_t>(segment.samples) * sizeof(int16_t));
+
+    if (!segment.tone)
+    {
+        // Restart the wave on the next tone, so every beep starts on the same edge.
+        m_phase = 0;
+        m_level = AUDIO_AMPLITUDE;
+        memset(m_block.data(), 0, m_block.size());
+    }
+    else
+    {
+        // The level flips every half period, tracked as a fraction of the sample rate.
+        for (uint32_t i = 0; i < segment.samples; i++)
+        {
+            // WAV samples are little-endian.
+            m_block[2 * i] = static_cast<uint8_t>(m_level);
+            m_block[2 * i + 1] = static_cast<uint8_t>(static_cast<uint16_t>(m_level) >> 8);
+
+            m_phase += 2 * m_tone_hz;
+            if (m_phase >= m_sample_rate)
+            {
+                m_phase -= m_sample_rate;
+                m_level = static_cast<int16_t>(-m_level);
+            }
+        }
+    }
+
+    fwrite(m_block.data(), 1, m_block.size(), m_file);
+    m_written.fetch_add(segment.samples, std::memory_order_relaxed);
+};
+
+void AudioRecorder::_writeSilence(uint32_t samples)
+{
+    // Restart the wave on the next tone, so every beep starts on the same edge.
+    m_phase = 0;
+    m_level = AUDIO_AMPLITUDE;
+
+    // Dropped segments can add up to a long silence, write it a block at a time.
+    uint32_t block = m_sample_rate * AUDIO_MAX_SEGMENT_MS / 1000 + 1;
+    m_block.assign(static_cast<size_t>(block < samples ? block : samples) * sizeof(int16_t), 0);
+
+    for (uint32_t left = samples; left > 0; )
+    {
+        uint32_t count = block < left ? block : left;
+        fwrite(m_block.data(), sizeof(int16_t), count, m_file);
+        left -= count;
+    }
+    m_written.fetch_add(samples, std::memory_order_relaxed);
+};
+
+void AudioRecorder::_writeHeader(uint32_t data_bytes)
+{
+    fwrite("RIFF", 1, 4, m_file);
+    PutU32(m_file, AUDIO_WAV_HEADER_SIZE - 8 + data_bytes);
+    fwrite("WAVE", 1, 4, m_file);
+
+    fwrite("fmt ", 1, 4, m_file);
+    PutU32(m_file, 16);                                 // Chunk size.
+    PutU16(m_file, 1);                                  // PCM.
+    PutU16(m_file, 1);                                  // Mono.
+    PutU32(m_file, m_sample_rate);
+    PutU32(m_file, m_sample_rate * sizeof(int16_t));    // Byte rate.
+    PutU16(m_file, sizeof(int16_t));                    // Block align.
+    PutU16(m_file, 16);                                 // Bits per sample.
+
+    fwrite("data", 1, 4, m_file);
+    PutU32(m_file, data_bytes);
+};
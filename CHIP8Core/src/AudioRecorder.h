@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CHIP8.h"
+
+/* Audio recorder
+* Renders the tone produced by the sound timer into a 16 bits mono PCM WAV file.
+*
+* Time is emulated time : one frame of CHIP8_CYCLES_PER_FRAME cycles lasts exactly 1/60 s,
+* the same timeline FrameRecorder uses, so audio and video of a run stay in lockstep.
+* Cycle() is called after every emulated cycle and decides whether the samples of that
+* cycle are tone or silence, so the output is sample-accurate to the cycle the timer changed.
+*
+* The emulation thread only queues (state, sample count) segments into a single-producer /
+* single-consumer ring. A background thread synthesizes the square wave and writes the file.
+* When the ring is full the segment is dropped and counted, like FrameRecorder, but its samples
+* are written as silence ahead of the next queued segment, so the timeline never gets shorter.
+*/
+class AudioRecorder
+{
+public:
+    AudioRecorder(const std::string& filepath, unsigned int sample_rate = 44100, unsigned int tone_hz = 440,
+                  unsigned int capacity = 1024);
+    // Drain the ring, patch the WAV sizes and close the file.
+    ~AudioRecorder();
+
+    AudioRecorder(const AudioRecorder&) = delete;
+    AudioRecorder& operator=(const AudioRecorder&) = delete;
+
+    bool IsOpen() const;
+
+    // Account for one emulated cycle of chip8. Never blocks.
+    void Cycle(const CHIP8& chip8);
+
+    // True while a new segment would be dropped. Callers without a real-time deadline can wait on this.
+    bool Full() const;
+
+    // Segments which did not fit the ring, written as silence instead.
+    uint64_t Dropped() const;
+    // Samples written to the file so far.
+    uint64_t Written() const;
+private:
+    struct Segment
+    {
+        uint32_t samples;
+        uint8_t tone;
+        // Samples of dropped segments to write as silence first.
+        uint32_t lost;
+    };
+
+    // Queue the pending segment. Return false when it was dropped.
+    bool _flush();
+    void _writer();
+    void _writeSegment(const Segment& segment);
+    void _writeSilence(uint32_t samples);
+    void _writeHeader(uint32_t data_bytes);
+private:
+    FILE                    *m_file;
+    unsigned int            m_sample_rate;
+    unsigned int            m_tone_hz;
+
+    // Producer side : emulated cycles so far, samples accounted for, and the segment being extended.
+    uint64_t                m_cycles;
+    uint64_t                m_samples;
+    Segment                 m_pending;
+    // Samples of dropped segments not handed to the writer yet.
+    uint64_t                m_lost;
+
+    std::vector<Segment>    m_ring;
+    // head is only written by the producer, tail only by the writer thread.
+    alignas(64) std::atomic<uint64_t> m_head;
+    alignas(64) std::atomic<uint64_t> m_tail;
+
+    std::atomic<uint64_t>   m_dropped;
+    std::atomic<uint64_t>   m_written;
+    std::atomic<bool>       m_stop;
+
+    // Writer side : square wave phase and output level.
+    uint32_t                m_phase;
+    int16_t                 m_level;
+    std::vector<uint8_t>    m_block;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    std::thread             m_thread;
+};
@@ -1,7 +1,13 @@
-#pragma once
-
-#include "pch.h"
 #include "CHIP8.h"
+#include "CHIP8Pool.h"
+#include "RomCache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// Clone(), Reset() and the loads copy whole machines with the implicit assignment.
+static_assert(std::is_trivially_copyable<CHIP8>::value, "CHIP8 must stay plain data");
 
 #define DECODE_X(opcode)    static_cast<uint8_t>((opcode & 0x0F00) >> 8)
 #define DECODE_Y(opcode)    static_cast<uint8_t>((opcode & 0x00F0) >> 4)
@@ -9,39 +15,80 @@
 #define DECODE_NN(opcode)   static_cast<uint8_t>(opcode & 0x00FF)
 #define DECODE_NNN(opcode)  static_cast<uint16_t>(opcode & 0x0FFF)
 
+#define CHIP8_DEFAULT_SEED 0x2545F491u
+
+// Fetched instead of reading past memory. FXFF does not exist, so the machine stops in FAULT_UNDEFINED.
+#define CHIP8_FETCH_OUT_OF_RANGE 0xFFFF
+
 #define UNDEFINED_OPCODE(x) \
-    std::cout << "OPCODE Error: " << std::hex << x << std::dec << " not exist." << std::endl; \
-    exit(3)
+    operation = &CHIP8::FAULT_UNDEFINED
 
 CHIP8::CHIP8()
+    : rng_state(CHIP8_DEFAULT_SEED)
 {
-    initialize();
+    _powerOn();
 };
 
-CHIP8::~CHIP8()
+void CHIP8::initialize()
 {
-    // nothing to free in memory.
+    // Every machine starts as a copy of one blank machine, built on first use.
+    static const CHIP8 blank;
+    _image(blank);
 };
 
-void CHIP8::initialize()
+void CHIP8::Reset()
+{
+    if (power_on != nullptr)
+        _image(*power_on);
+    else
+        initialize();
+};
+
+void CHIP8::_image(const CHIP8& image)
+{
+    uint32_t rng = rng_state;
+    *this = image;
+    rng_state = rng;
+};
+
+void CHIP8::_flash(const uint8_t* data, size_t size)
 {
+    // Load binary data into emulated memory. Starts from 0x200.
+    if (size != 0)
+        memcpy(memory + 0x200, data, size);
+    power_on = this;
+};
+
+void CHIP8::_powerOn()
+{
+    // The layout described in CHIP8.h : one hot line, one cold line, then memory and screen on whole lines.
+    static_assert(offsetof(CHIP8, fault_info) + sizeof(fault_info) <= 64, "hot state must fit in the first cache line");
+    static_assert(offsetof(CHIP8, stack) == 64, "stack must start the second cache line");
+    static_assert(offsetof(CHIP8, memory) % 64 == 0 && offsetof(CHIP8, screen) % 64 == 0, "arrays must start on a cache line");
+    static_assert(sizeof(CHIP8) % 64 == 0, "instances must not share cache lines");
+
     // Reset all the memory address, registers, operation variables to original values.
     unsigned int i;
 
     for (i = 0; i < CHIP8_REGISTER_SIZE; i++) V[i] = 0;
     for (i = 0; i < CHIP8_MEMORY_SIZE; i++) memory[i] = 0;
     for (i = 0; i < CHIP8_STACK_SIZE; i++) stack[i] = 0;
-    for (i = 0; i < CHIP8_KEY_SIZE; i++) key[i] = 0;
+    keys = 0;
     for (i = 0; i < CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT; i++) screen[i] = 0;
 
     delay_timer = 0;
     sound_timer = 0;
 
     sp = 0;
+    draw_flag = 1; // Present the cleared screen once after reset.
+    dirty_rows = CHIP8_ALL_ROWS;
     fetched = 0x0;
     I = 0x0;
     PC = 0x200; // Client program starts from 0x200 in memory address;
 
+    fault_info = { CHIP8Fault::NONE, 0, 0 };
+    power_on = nullptr;
+
     // Load font sprites data into memory.
     // Each font sprites are 4*5 pixels.
     //
@@ -73,45 +120,47 @@ void CHIP8::initialize()
     for (i = 0; i < 5 * 16; i++) memory[i] = font_sprites[i];
 };
 
-void CHIP8::Load(const std::string& filepath)
+CHIP8Fault CHIP8::Load(const std::string& filepath)
 {
-    initialize();
-
-    unsigned int i;
-    std::ifstream file;
-    file.open(filepath, std::ifstream::binary);
+    // The file is only read the first time, later loads copy the cached power-on image.
+    CHIP8Fault fault;
+    const RomImage* rom = RomCache::Instance().Get(filepath, fault);
 
-    if (file.is_open())
+    if (rom == nullptr)
     {
-        std::filebuf* pbuf = file.rdbuf();
-
-        size_t file_size = pbuf->pubseekoff(0, file.end, file.in);
-        pbuf->pubseekpos(0, file.in);
-
-        if (file_size > 4096 - 512)
-        {
-            printf("File Error: Cannot load the game file with size %i\n", file_size);
-            exit(-1);
-        }
+        initialize();
+        fault_info = { fault, PC, 0 };
+        return fault;
+    }
 
-        char* buffer = new char[file_size];
-        pbuf->sgetn(buffer, file_size);
+    _image(*rom->power_on);
+    return CHIP8Fault::NONE;
+};
 
-        // Load binary data into emulated memory. Starts from 0x200.
-        for (i = 0; i < file_size; i++)
-            memory[i + 0x200] = (uint8_t)buffer[i];
+CHIP8Fault CHIP8::LoadBytes(const uint8_t* data, size_t size)
+{
+    // Bytes are often generated or fuzzed, caching them would keep every distinct program until exit.
+    initialize();
 
-        file.close();
-        delete[] buffer;
-    }
-    else
+    if (size > CHIP8_MEMORY_SIZE - 0x200)
     {
-        printf("File Error: Cannot open the game at %s\n", filepath);
-        exit(-1);
+        fault_info = { CHIP8Fault::ROM_TOO_LARGE, PC, 0 };
+        return CHIP8Fault::ROM_TOO_LARGE;
     }
+
+    if (size != 0)
+        memcpy(memory + 0x200, data, size);
+    return CHIP8Fault::NONE;
 };
 
-void CHIP8::EmulateCycle()
+void CHIP8::KeepResetImage(CHIP8& image)
+{
+    // Point at image first, so the image points to itself like the ones in RomCache.
+    power_on = &image;
+    image = *this;
+};
+
+CHIP8FaultInfo CHIP8::EmulateCycle()
 {
     /* Emulated all the process CPU take within one Cycle
     *  Fetching opcode from memory and storing into Program Counter.
@@ -123,6 +172,183 @@ void CHIP8::EmulateCycle()
     _decode();
     _execute();
     _timing();
+
+    return fault_info;
+};
+
+CHIP8FaultInfo CHIP8::RunCycles(unsigned int n)
+{
+    // No per-cycle fault check here, see the comment on fault_info.
+    for (unsigned int i = 0; i < n; i++)
+    {
+        _fetch();
+        _decode();
+        _execute();
+        _timing();
+    }
+
+    return fault_info;
+};
+
+CHIP8FaultInfo CHIP8::RunFrame()
+{
+    return RunCycles(CHIP8_CYCLES_PER_FRAME);
+};
+
+const CHIP8FaultInfo& CHIP8::Fault() const
+{
+    return fault_info;
+};
+
+const char* CHIP8::FaultName(CHIP8Fault fault)
+{
+    switch (fault)
+    {
+    case CHIP8Fault::NONE:              return "none";
+    case CHIP8Fault::UNDEFINED_OPCODE:  return "undefined opcode";
+    case CHIP8Fault::STACK_OVERFLOW:    return "stack overflow";
+    case CHIP8Fault::STACK_UNDERFLOW:   return "stack underflow";
+    case CHIP8Fault::ROM_NOT_FOUND:     return "ROM not found";
+    case CHIP8Fault::ROM_TOO_LARGE:     return "ROM too large";
+    case CHIP8Fault::PC_OUT_OF_RANGE:   return "PC out of range";
+    case CHIP8Fault::MEMORY_OVERRUN:    return "memory overrun";
+    }
+    return "unknown";
+};
+
+void CHIP8::Seed(uint32_t seed)
+{
+    // Xorshift gets stuck at zero, so fall back to the default seed.
+    rng_state = seed ? seed : CHIP8_DEFAULT_SEED;
+};
+
+void CHIP8::SetKey(uint8_t k, uint8_t pressed)
+{
+    uint16_t bit = static_cast<uint16_t>(1u << (k & 0xF));
+    keys = pressed ? keys | bit : keys & ~bit;
+};
+
+CHIP8* CHIP8::Clone(CHIP8Pool& pool) const
+{
+    CHIP8* clone = pool.Acquire();
+    if (clone != nullptr)
+        *clone = *this;
+    return clone;
+};
+
+void CHIP8::Snapshot(CHIP8State& state) const
+{
+    memcpy(state.memory, memory, sizeof(memory));
+    memcpy(state.V, V, sizeof(V));
+    state.I = I;
+    state.PC = PC;
+    memcpy(state.stack, stack, sizeof(stack));
+    state.sp = sp;
+    state.delay_timer = delay_timer;
+    state.sound_timer = sound_timer;
+    for (unsigned int k = 0; k < CHIP8_KEY_SIZE; k++)
+        state.key[k] = (keys >> k) & 1;
+    memcpy(state.screen, screen, sizeof(screen));
+    state.draw_flag = draw_flag;
+    state.rng_state = rng_state;
+    state.fault_info = fault_info;
+};
+
+bool CHIP8::Restore(const CHIP8State& state)
+{
+    // PC and I need no check, see the header.
+    if (state.sp > CHIP8_STACK_SIZE)
+        return false;
+
+    memcpy(memory, state.memory, sizeof(memory));
+    memcpy(V, state.V, sizeof(V));
+    I = state.I;
+    PC = state.PC;
+    memcpy(stack, state.stack, sizeof(stack));
+    sp = state.sp;
+    delay_timer = state.delay_timer;
+    sound_timer = state.sound_timer;
+    keys = 0;
+    for (unsigned int k = 0; k < CHIP8_KEY_SIZE; k++)
+        keys |= static_cast<uint16_t>(state.key[k] ? 1u << k : 0u);
+    memcpy(screen, state.screen, sizeof(screen));
+    draw_flag = state.draw_flag;
+    // The restored screen has nothing in common with what was presented before.
+    dirty_rows = CHIP8_ALL_ROWS;
+    rng_state = state.rng_state;
+    fault_info = state.fault_info;
+    fetched = 0x0;
+    return true;
+};
+
+const uint8_t* CHIP8::Screen() const
+{
+    return screen;
+};
+
+void CHIP8::PackScreen(uint8_t* out) const
+{
+    // Pixels are 0 or 1, so 8 of them fold into one byte.
+    for (unsigned int b = 0; b < CHIP8_PACKED_SCREEN_SIZE; b++)
+    {
+        const uint8_t* p = screen + b * 8;
+        out[b] = static_cast<uint8_t>(
+            (p[0] << 7) | (p[1] << 6) | (p[2] << 5) | (p[3] << 4) |
+            (p[4] << 3) | (p[5] << 2) | (p[6] << 1) | p[7]);
+    }
+};
+
+uint32_t CHIP8::TakeDirtyRows()
+{
+    uint32_t rows = dirty_rows;
+    dirty_rows = 0;
+    return rows;
+};
+
+bool CHIP8::WaitingForKey() const
+{
+    if (PC + 1 >= CHIP8_MEMORY_SIZE || (memory[PC] & 0xF0) != 0xF0 || memory[PC + 1] != 0x0A)
+        return false;
+
+    // Running timers still change the state every cycle.
+    if (delay_timer != 0 || sound_timer != 0)
+        return false;
+
+    return keys == 0;
+};
+
+uint64_t CHIP8::Hash() const
+{
+    // Hash every field which affects the future of the machine.
+    // Operation variables are skipped since they are rebuilt on every cycle.
+    uint64_t h = 0xCBF29CE484222325ull;
+
+    auto mix = [&h](const void* data, size_t len) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < len; i++)
+        {
+            h ^= bytes[i];
+            h *= 0x100000001B3ull;
+        }
+    };
+
+    mix(memory, sizeof(memory));
+    mix(V, sizeof(V));
+    mix(&I, sizeof(I));
+    mix(&PC, sizeof(PC));
+    mix(stack, sizeof(stack));
+    mix(&sp, sizeof(sp));
+    mix(&delay_timer, sizeof(delay_timer));
+    mix(&sound_timer, sizeof(sound_timer));
+    // Hashed as one byte per key, like CHIP8State, so hashes do not depend on how keys are stored.
+    uint8_t key[CHIP8_KEY_SIZE];
+    for (unsigned int k = 0; k < CHIP8_KEY_SIZE; k++)
+        key[k] = (keys >> k) & 1;
+    mix(key, sizeof(key));
+    mix(screen, sizeof(screen));
+    mix(&rng_state, sizeof(rng_state));
+
+    return h;
 };
 
 void CHIP8::_fetch()
@@ -134,7 +360,9 @@ void CHIP8::_fetch()
     //           memory[PC+1]    = 00 00 00 00 00 10 00 01
     //           BITWISE | OP  ----------------------------
     //           fetched         = 00 11 01 11 00 10 00 01 (original opcode)
-    fetched = (uint16_t)memory[PC] << 8 | (uint16_t)memory[PC + 1];
+    //
+    // A jump to 0xFFF, or BNNN past it, leaves no whole opcode at PC.
+    fetched = PC < CHIP8_MEMORY_SIZE - 1 ? (uint16_t)memory[PC] << 8 | (uint16_t)memory[PC + 1] : CHIP8_FETCH_OUT_OF_RANGE;
 };
 
 void CHIP8::_decode()
@@ -349,6 +577,13 @@ void CHIP8::_timing()
         --sound_timer;
 };
 
+void CHIP8::_fault(CHIP8Fault fault)
+{
+    // Keep the first fault, later ones are only the machine re-executing it.
+    if (fault_info.fault == CHIP8Fault::NONE)
+        fault_info = { fault, PC, fetched };
+};
+
 
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -356,6 +591,12 @@ void CHIP8::_timing()
 /////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
+void CHIP8::FAULT_UNDEFINED()
+{
+    // Stop on the opcode which does not exist. PC is not advanced.
+    _fault(PC < CHIP8_MEMORY_SIZE - 1 ? CHIP8Fault::UNDEFINED_OPCODE : CHIP8Fault::PC_OUT_OF_RANGE);
+};
+
 void CHIP8::CALL_0NNN()
 {
     // Call RCA 1802 Program at address of NNN.
@@ -368,12 +609,18 @@ void CHIP8::DISPLAY_00E0()
     unsigned int i;
     for (i = 0; i < CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT; i++) screen[i] = 0;
     draw_flag = 1;
+    dirty_rows = CHIP8_ALL_ROWS;
     PC += 2;
 };
 
 void CHIP8::FLOW_00EE()
 {
     // Return from the subroutine.
+    if (sp == 0)
+    {
+        _fault(CHIP8Fault::STACK_UNDERFLOW);
+        return;
+    }
     PC = stack[--sp];
     // Since the previous PC is the one which enter the subroutine,
     // it is necessary to forward the PC prevent infinate loop.
@@ -391,6 +638,11 @@ void CHIP8::FLOW_2NNN()
 {
     // Call the subroutine at NNN.
     uint16_t NNN = DECODE_NNN(fetched);
+    if (sp == CHIP8_STACK_SIZE)
+    {
+        _fault(CHIP8Fault::STACK_OVERFLOW);
+        return;
+    }
     stack[sp++] = PC;
     PC = NNN;
 };
@@ -568,7 +820,11 @@ void CHIP8::RAND_CXNN()
     // Assign result of bitwise AND operation between random number and NN to VX.
     uint8_t X = DECODE_X(fetched);
     uint8_t NN = DECODE_NN(fetched);
-    V[X] = NN & (rand() % (0xFF + 1)); // make sure random number is within range of 0-255.
+    // Xorshift32 keeps the sequence private to this instance.
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    V[X] = NN & static_cast<uint8_t>(rng_state >> 24); // make sure random number is within range of 0-255.
     PC += 2;
 };
 
@@ -598,29 +854,41 @@ void CHIP8::DISP_DXYN()
 
     unsigned int pos;
 
+    // The sprite rows are read from memory[I] to memory[I + N - 1].
+    if (I + N > CHIP8_MEMORY_SIZE)
+    {
+        _fault(CHIP8Fault::MEMORY_OVERRUN);
+        return;
+    }
+
     V[0xF] = 0;
 
     for (unsigned int h = 0; h < N; h++)
     {
         pixels = memory[I + h];
 
+        // XOR with an empty sprite row leaves the screen row as it is.
+        if (pixels != 0)
+            dirty_rows |= 1u << ((V[Y] + h) % CHIP8_SCREEN_HEIGHT);
+
         for (unsigned int w = 0; w < 8; w++)
         {
             // Get the position of current pixel on screen.
-            pos = V[X] + w + (V[Y] + h) * CHIP8_SCREEN_WIDTH;
+            // Sprites which cross the border wrap around to the other side.
+            pos = (V[X] + w) % CHIP8_SCREEN_WIDTH + ((V[Y] + h) % CHIP8_SCREEN_HEIGHT) * CHIP8_SCREEN_WIDTH;
 
             // If both new pixel and old pixel are 1, it indicates collesion detection.
             // Thus, set VF to 1.
             if ((pixels & (0x80 >> w)) && screen[pos])
                 V[0xF] = 1;
 
-            // Using 2 bytes mask - 1000 0000 shifts right by w to extract current pixel
+            // Shift the current pixel down to the lowest bit, so every screen byte stays 0 or 1.
             // Example : w = 4
-            //           1000 0000 >> 4 = 0000 1000
-            //                        XOR 1111 1111 -> original pixels in this row
-            //                        -------------
-            //                            0000 0000 -> new pixel will be 0x00
-            screen[pos] ^= static_cast<uint8_t>(pixels & (0x80 >> w));
+            //           1111 1111 >> (7 - 4) = 0001 1111
+            //                              & 0000 0001
+            //                              -----------
+            //                                0000 0001 -> flip the pixel on screen
+            screen[pos] ^= static_cast<uint8_t>((pixels >> (7 - w)) & 0x1);
         }
     }
 
@@ -631,9 +899,9 @@ void CHIP8::DISP_DXYN()
 
 void CHIP8::KEYOP_EX9E()
 {
-    // Skip the next 2 bytes of memeroy if key[VX] is pressed.
+    // Skip the next 2 bytes of memeroy if key[VX] is pressed. Values above F name no key, which is never pressed.
     uint8_t X = DECODE_X(fetched);
-    if (key[V[X]])
+    if (V[X] < CHIP8_KEY_SIZE && ((keys >> V[X]) & 1))
         PC += 4;
     else
         PC += 2;
@@ -643,7 +911,7 @@ void CHIP8::KEYOP_EXA1()
 {
     // Skip the next 2 bytes of memory if key[VX] is not pressed.
     uint8_t X = DECODE_X(fetched);
-    if (!key[V[X]])
+    if (V[X] >= CHIP8_KEY_SIZE || !((keys >> V[X]) & 1))
         PC += 4;
     else
         PC += 2;
@@ -663,11 +931,13 @@ void CHIP8::KEYOP_FX0A()
     // By not updating the PC value, it is essentially the same as io blocking behaviour.
     uint8_t X = DECODE_X(fetched);
 
-    unsigned int i;
+    if (keys == 0)
+        return;
 
-    for (i = 0; i < CHIP8_KEY_SIZE; i++)
+    // The lowest held key wins.
+    for (unsigned int i = 0; i < CHIP8_KEY_SIZE; i++)
     {
-        if (key[i])
+        if ((keys >> i) & 1)
         {
             V[X] = i;
             PC += 2;
@@ -729,6 +999,11 @@ void CHIP8::BCD_FX33()
     //memory[I + 1] = (X / 10) % 10;
     //memory[I + 2] = X % 10;
     //PC += 2;
+    if (I + 3 > CHIP8_MEMORY_SIZE)
+    {
+        _fault(CHIP8Fault::MEMORY_OVERRUN);
+        return;
+    }
     memory[I] = V[(fetched & 0x0F00) >> 8] / 100;
     memory[I + 1] = (V[(fetched & 0x0F00) >> 8] / 10) % 10;
     memory[I + 2] = V[(fetched & 0x0F00) >> 8] % 10;
@@ -740,6 +1015,11 @@ void CHIP8::MEM_FX55()
     // Store [V0 .. VX] into memory which starts from I.
     uint8_t X = DECODE_X(fetched);
     unsigned int i;
+    if (I + X + 1 > CHIP8_MEMORY_SIZE)
+    {
+        _fault(CHIP8Fault::MEMORY_OVERRUN);
+        return;
+    }
     for (i = 0; i <= X; i++)
         memory[I + i] = V[i];
     PC += 2;
@@ -750,6 +1030,11 @@ void CHIP8::MEM_FX65()
     // Fill [V0 .. VX] from memory which starts from I.
     uint8_t X = DECODE_X(fetched);
     unsigned int i;
+    if (I + X + 1 > CHIP8_MEMORY_SIZE)
+    {
+        _fault(CHIP8Fault::MEMORY_OVERRUN);
+        return;
+    }
     for (i = 0; i <= X; i++)
         V[i] = memory[I + i];
     PC += 2;
@@ -0,0 +1,283 @@
+#pragma once
+
+#define CHIP8_REGISTER_SIZE 16
+#define CHIP8_MEMORY_SIZE 4096
+#define CHIP8_STACK_SIZE 16
+#define CHIP8_KEY_SIZE 16
+#define CHIP8_SCREEN_WIDTH 64
+#define CHIP8_SCREEN_HEIGHT 32
+#define CHIP8_MICROSECOND_PER_CYCLE 1300
+#define CHIP8_CYCLES_PER_FRAME (16667 / CHIP8_MICROSECOND_PER_CYCLE)
+// Bytes of a bit-packed screen : 8 pixels per byte, leftmost pixel in the most significant bit.
+#define CHIP8_PACKED_SCREEN_SIZE (CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT / 8)
+// One bit per screen row, see dirty_rows.
+#define CHIP8_ALL_ROWS 0xFFFFFFFFu
+
+// The core is built as a static library without any SDL dependency,
+// so only the standard headers it needs are included here.
+#include <cstdint>
+#include <string>
+
+class CHIP8;
+class CHIP8Pool;
+class SharedFramePublisher;
+class AudioRecorder;
+class Window;
+class EventHandler;
+class AudioPlayer;
+
+typedef void (CHIP8::* op_fun)();
+
+/* Faults
+* The core never exits the process. An instruction which cannot run, or would access memory out of bounds,
+* stops the machine on itself instead, and the fault is reported to the caller.
+*/
+enum class CHIP8Fault : uint8_t
+{
+    NONE = 0,
+    UNDEFINED_OPCODE,   // Fetched opcode does not exist.
+    STACK_OVERFLOW,     // 2NNN with all 16 stack levels in use.
+    STACK_UNDERFLOW,    // 00EE with an empty stack.
+    ROM_NOT_FOUND,      // Load() cannot open the file.
+    ROM_TOO_LARGE,      // Load() got a file which does not fit above 0x200.
+    PC_OUT_OF_RANGE,    // No whole opcode left to fetch at PC, e.g. after BNNN past 0xFFE.
+    MEMORY_OVERRUN      // DXYN, FX33, FX55 or FX65 would access memory past 0xFFF through I.
+};
+
+struct CHIP8FaultInfo
+{
+    CHIP8Fault fault;
+    uint16_t pc;        // Address of the faulting instruction.
+    uint16_t opcode;    // Faulting opcode, 0 for load faults.
+};
+
+/* State
+* Plain copy of everything which defines a running machine, for snapshots and save states.
+* It holds no pointers, so it can be stored, sent to another process and restored there.
+*/
+struct CHIP8State
+{
+    uint8_t memory[CHIP8_MEMORY_SIZE];
+    uint8_t V[CHIP8_REGISTER_SIZE];
+    uint16_t I, PC;
+    uint16_t stack[CHIP8_STACK_SIZE];
+    uint16_t sp;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t key[CHIP8_KEY_SIZE];
+    uint8_t screen[CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT];
+    uint8_t draw_flag;
+    uint32_t rng_state;
+    CHIP8FaultInfo fault_info;
+};
+
+/* CHIP8
+* The whole machine is plain data and aligned to cache lines, so copying one instance into another
+* (Clone(), Reset(), loading a ROM) is a single bulk copy of whole lines.
+*/
+class alignas(64) CHIP8
+{
+    friend class RomCache;
+    friend class Window;
+    friend class EventHandler;
+    friend class AudioPlayer;
+    friend class SharedFramePublisher;
+    friend class AudioRecorder;
+public:
+    CHIP8();
+
+    // Initialize the emulated hardware. The random generator keeps its state.
+    void initialize();
+
+    // Go back to the power-on state of the last loaded ROM, with one bulk copy of its prebuilt image.
+    // The random generator keeps its state like initialize(), reseed to replay an episode. Without a ROM this is initialize().
+    void Reset();
+
+    // Load ROM into memory.
+    // Return ROM_NOT_FOUND or ROM_TOO_LARGE instead of loading a partial program.
+    CHIP8Fault Load(const std::string& filepath);
+
+    // Load ROM image from memory, e.g. bytes handed over through the C ABI.
+    // The bytes are not cached, so Reset() goes back to a blank machine until KeepResetImage() is called.
+    CHIP8Fault LoadBytes(const uint8_t* data, size_t size);
+
+    // Copy this machine into image and make Reset() go back to it, e.g. right after LoadBytes().
+    // image must stay alive as long as this machine, or a copy of it, may call Reset().
+    void KeepResetImage(CHIP8& image);
+
+    // Emulate the operations per CPU cycle.
+    CHIP8FaultInfo EmulateCycle();
+
+    // Emulate n cycles. The fault is only checked once after the loop, since a faulted machine
+    // stays on the faulting instruction without executing it. Only the timers keep counting down.
+    CHIP8FaultInfo RunCycles(unsigned int n);
+
+    // Emulate all the cycles which fit into one 60 Hz frame.
+    CHIP8FaultInfo RunFrame();
+
+    // The first fault since the last initialize(), or NONE.
+    const CHIP8FaultInfo& Fault() const;
+
+    // Readable name of a fault, for logging.
+    static const char* FaultName(CHIP8Fault fault);
+
+    // Seed the random number generator used by CXNN.
+    // Every instance owns its generator, so runs are reproducible across threads.
+    void Seed(uint32_t seed);
+
+    // Set the state of key (0x0 - 0xF) without going through SDL.
+    void SetKey(uint8_t k, uint8_t pressed);
+
+    // Fork this machine into an independent copy taken from pool.
+    // The copy is a plain member-wise copy, so it costs one bulk copy of the state and no allocation.
+    // Return nullptr when the pool is exhausted.
+    CHIP8* Clone(CHIP8Pool& pool) const;
+
+    // Copy the machine state out to / back in from a CHIP8State.
+    // Restore rejects states whose stack pointer is out of range. PC and I are taken as they are :
+    // jumps and FX1E can legitimately move them past 0xFFF, and every access through them is bounds-checked.
+    void Snapshot(CHIP8State& state) const;
+    bool Restore(const CHIP8State& state);
+
+    // Read-only access to the 64*32 screen buffer, one byte per pixel.
+    const uint8_t* Screen() const;
+
+    // Write the screen bit-packed into CHIP8_PACKED_SCREEN_SIZE bytes at out.
+    void PackScreen(uint8_t* out) const;
+
+    // Rows changed since the last call as a bit mask, bit y for row y, and clear the mask.
+    // Zero means the screen is unchanged and does not need to be uploaded again.
+    uint32_t TakeDirtyRows();
+
+    // True when the next cycles are no-ops until a key is pressed : PC sits on FX0A, no key is held
+    // and both timers are stopped. Frontends can block on input instead of spinning then.
+    bool WaitingForKey() const;
+
+    // 64 bits FNV-1a hash over the entire machine state.
+    uint64_t Hash() const;
+private:
+    // Fetch operation from memory and store into opcode.
+    void _fetch();
+    // Decode opcode and store required value into operation varaiables.
+    void _decode();
+    // Execute operation based on operation variables.
+    void _execute();
+    // Update timing based on operation variables.
+    void _timing();
+    // Record the first fault with the current PC and opcode.
+    void _fault(CHIP8Fault fault);
+    // Build the blank power-on state field by field. Only used to build the images the other paths copy.
+    void _powerOn();
+    // Become a copy of image, keeping rng_state.
+    void _image(const CHIP8& image);
+    // Turn this blank machine into the power-on image of a program, for RomCache.
+    void _flash(const uint8_t* data, size_t size);
+
+private:
+    /* Emulated functions for CPU operations.
+    * Since most of the operations' name in CHIP-8 start with numbers,
+    * to prevent illegle fuction name, the naming convention here will be <TYPE>_<OPCODE>.
+    */
+    void CALL_0NNN();   void DISPLAY_00E0();    void FLOW_00EE();
+    void COND_3XNN();   void COND_4XNN();    void COND_5XY0();
+    void CONST_6XNN();   void CONST_7XNN();    void ASSIGN_8XY0();
+    void BITOP_8XY1();   void BITOP_8XY2();    void BITOP_8XY3();
+    void MATH_8XY4();   void MATH_8XY5();    void BITOP_8XY6();
+    void MATH_8XY7();   void BITOP_8XYE();    void COND_9XY0();
+    void MEM_ANNN();   void FLOW_BNNN();    void RAND_CXNN();
+    void DISP_DXYN();   void KEYOP_EX9E();    void KEYOP_EXA1();
+    void TIMER_FX07();   void KEYOP_FX0A();    void TIMER_FX15();
+    void SOUND_FX18();   void MEM_FX1E();    void MEM_FX29();
+    void BCD_FX33();   void MEM_FX55();    void MEM_FX65();
+    void FLOW_1NNN();   void FLOW_2NNN();
+
+    // Handler for opcodes which do not exist. Records the fault without moving PC.
+    void FAULT_UNDEFINED();
+
+private:
+    /* Layout
+    * Line 0 (hot)  : everything a cycle reads or writes besides memory and screen, see the static_asserts in CHIP8.cpp.
+    * Line 1 (cold) : stack, only touched by 2NNN / 00EE, and the power-on image pointer.
+    * Then memory and screen, each starting on its own line.
+    * sizeof(CHIP8) is a multiple of 64, so neighbours in an array (CHIP8Pool, VecEnv) never share
+    * a cache line, and threads stepping different instances never write to the same line.
+    */
+
+    /* Operation varaiables
+    *   operation   : function pointer for current operation.
+    *   fetched     : current cycle fetched opcode.
+    */
+    alignas(64) op_fun operation;
+    uint16_t fetched;
+
+    /* Registers
+    * CHIP-8 has 16 1 bytes registers named V0 to VF.
+    * VF is a flag register for special purpose.
+    * There are also two address registers which are 2 bytes long :
+    *       I : Store memory address for CPU operations.
+    *       PC: Program Counter register. Used for storing current reading memory address.
+    */
+    uint16_t I, PC;
+    uint16_t sp;
+    uint8_t V[CHIP8_REGISTER_SIZE];
+
+    /* Timer
+    * CHIP-8 has two timers which will start counting in 60 Hz when the values are above 0.
+    * Delay Timer: Using for game event.
+    * Sound TImer: Using for sound event.
+    */
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+
+    uint8_t draw_flag;
+
+    /* Input
+    * CHIP-8 comes with hex keyboard.
+    * The key ranges from 0 to F, bit k of the mask is set while key k is held.
+    */
+    uint16_t keys;
+
+    /* Dirty rows
+    * Bit y is set when DXYN or 00E0 may have changed row y since the last TakeDirtyRows().
+    * It only describes presentation, so like draw_flag it is not part of CHIP8State or Hash().
+    */
+    uint32_t dirty_rows;
+
+    /* Random
+    * Internal xorshift state for CXNN, replacing the process-wide rand().
+    */
+    uint32_t rng_state;
+
+    /* Fault
+    * First fault since initialize(). Faulting handlers never advance PC,
+    * so the machine keeps re-executing the faulting instruction until reset.
+    */
+    CHIP8FaultInfo fault_info;
+
+    /* Stack
+    * CHIP-8's stack is only used for storing return address when branching.
+    * It has 16 level of nesting and sp records the current nesting level.
+    */
+    alignas(64) uint16_t stack[CHIP8_STACK_SIZE];
+
+    /* Power-on image
+    * Pristine machine of the loaded ROM. Reset() copies it. Owned by RomCache and never freed after Load(),
+    * owned by the caller after KeepResetImage().
+    * An image points to itself, so copying one also sets this. nullptr while no ROM is loaded.
+    */
+    const CHIP8* power_on;
+
+    /* Memory
+    * CHI-8 had 4096 memory addresses. Each of the addresses are 1 bytes long.
+    * The first 512 bytes spaces are preserved for machine's usage.
+    * The uppermost 256 bytes are for display refresh, and 96 bytes before that are call stack.
+    * The user program should start at address 0x200.
+    */
+    alignas(64) uint8_t memory[CHIP8_MEMORY_SIZE];
+
+    /* Graphic
+    * CHIP-8 handles graphic in a 64*32 screen with totally 2048 pixels.
+    * One byte per pixel, so Screen() and the C ABI hand it out without a conversion.
+    */
+    alignas(64) uint8_t screen[CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT];
+};
@@ -0,0 +1,64 @@
+#include "CHIP8Pool.h"
+
+#include <algorithm>
+
+CHIP8Pool::CHIP8Pool(unsigned int capacity)
+    : m_instances(capacity), m_in_use(capacity, 0)
+{
+    m_free.reserve(capacity);
+    ReleaseAll();
+};
+
+CHIP8Pool::~CHIP8Pool()
+{
+    // Instances are owned by the vector.
+};
+
+CHIP8* CHIP8Pool::Acquire()
+{
+    if (m_free.empty())
+        return nullptr;
+
+    uint32_t index = m_free.back();
+    m_free.pop_back();
+    m_in_use[index] = 1;
+    return &m_instances[index];
+};
+
+bool CHIP8Pool::Release(CHIP8* chip8)
+{
+    // Compare addresses as integers, pointer arithmetic on a foreign pointer is undefined.
+    uintptr_t address = reinterpret_cast<uintptr_t>(chip8);
+    uintptr_t base = reinterpret_cast<uintptr_t>(m_instances.data());
+    if (chip8 == nullptr || address < base || (address - base) % sizeof(CHIP8) != 0)
+        return false;
+
+    size_t index = (address - base) / sizeof(CHIP8);
+    if (index >= m_instances.size() || !m_in_use[index])
+        return false;
+
+    // The free list was reserved to full capacity, and a double release is refused above,
+    // so this never reallocates.
+    m_in_use[index] = 0;
+    m_free.push_back(static_cast<uint32_t>(index));
+    return true;
+};
+
+void CHIP8Pool::ReleaseAll()
+{
+    // Hand out low indices first so a small search stays in a compact memory range.
+    std::fill(m_in_use.begin(), m_in_use.end(), 0);
+    m_free.clear();
+    for (size_t i = m_instances.size(); i > 0; i--)
+        m_free.push_back(static_cast<uint32_t>(i - 1));
+};
+
+unsigned int CHIP8Pool::Capacity() const
+{
+    return static_cast<unsigned int>(m_instances.size());
+};
+
+unsigned int CHIP8Pool::Available() const
+{
+    return static_cast<unsigned int>(m_free.size());
+};
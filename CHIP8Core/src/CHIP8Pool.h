@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "CHIP8.h"
+
+/* CHIP8Pool
+* Preallocated storage for CHIP8 instances, used by CHIP8::Clone().
+* All the instances are constructed up front, so acquiring and releasing one
+* never touches the heap. The pool is not thread-safe, use one pool per thread.
+*/
+class CHIP8Pool
+{
+public:
+    // Preallocate capacity instances.
+    explicit CHIP8Pool(unsigned int capacity);
+    ~CHIP8Pool();
+
+    CHIP8Pool(const CHIP8Pool&) = delete;
+    CHIP8Pool& operator=(const CHIP8Pool&) = delete;
+
+    // Take a free instance. Return nullptr when the pool is exhausted.
+    CHIP8* Acquire();
+
+    // Give an instance back to the pool. nullptr, instances from elsewhere and instances
+    // which are not acquired are ignored, return false for those.
+    bool Release(CHIP8* chip8);
+
+    // Release every instance at once, e.g. between two search iterations.
+    void ReleaseAll();
+
+    unsigned int Capacity() const;
+    unsigned int Available() const;
+private:
+    std::vector<CHIP8>      m_instances;
+    std::vector<uint32_t>   m_free;
+    // 1 while the instance at the same index is acquired.
+    std::vector<uint8_t>    m_in_use;
+};
@@ -0,0 +1,134 @@
+#include "FrameDelta.h"
+
+#include <cstring>
+
+// A literal run only ends at this many zero bytes, shorter gaps are cheaper to send than a new chunk header.
+#define FRAMEDELTA_MIN_ZERO_RUN 3
+
+FrameDeltaEncoder::FrameDeltaEncoder(unsigned int keyframe_interval)
+    : m_interval(keyframe_interval), m_since(0), m_keyframe(true)
+{
+    memset(m_previous, 0, sizeof(m_previous));
+};
+
+bool FrameDeltaEncoder::Encode(const uint8_t* packed, std::vector<uint8_t>& out)
+{
+    bool keyframe = m_keyframe || (m_interval != 0 && m_since >= m_interval);
+    if (keyframe)
+    {
+        memset(m_previous, 0, sizeof(m_previous));
+        m_since = 0;
+        m_keyframe = false;
+    }
+    m_since++;
+
+    uint8_t delta[CHIP8_PACKED_SCREEN_SIZE];
+    size_t end = 0;
+    for (size_t i = 0; i < CHIP8_PACKED_SCREEN_SIZE; i++)
+    {
+        delta[i] = packed[i] ^ m_previous[i];
+        if (delta[i])
+            end = i + 1;
+    }
+    memcpy(m_previous, packed, sizeof(m_previous));
+
+    out.push_back(keyframe ? FRAMEDELTA_KEYFRAME : FRAMEDELTA_DELTA);
+
+    // end is one past the last changed byte, the zeros after it are implied.
+    size_t i = 0;
+    while (i < end)
+    {
+        size_t zeros = 0;
+        while (i + zeros < end && delta[i + zeros] == 0 && zeros < 255)
+            zeros++;
+
+        size_t start = i + zeros;
+        size_t literals = 0;
+        while (start + literals < end && literals < 255)
+        {
+            // Stop in front of a zero run long enough to be worth its own chunk.
+            size_t run = 0;
+            while (run < FRAMEDELTA_MIN_ZERO_RUN && start + literals + run < end && delta[start + literals + run] == 0)
+                run++;
+            if (run == FRAMEDELTA_MIN_ZERO_RUN)
+                break;
+            literals += run ? run : 1;
+        }
+        if (literals > 255)
+            literals = 255;
+
+        out.push_back(static_cast<uint8_t>(zeros));
+        out.push_back(static_cast<uint8_t>(literals));
+        out.insert(out.end(), delta + start, delta + start + literals);
+        i = start + literals;
+    }
+
+    return keyframe;
+};
+
+void FrameDeltaEncoder::ForceKeyframe()
+{
+    m_keyframe = true;
+};
+
+FrameDeltaDecoder::FrameDeltaDecoder()
+    : m_valid(false)
+{
+    memset(m_packed, 0, sizeof(m_packed));
+};
+
+bool FrameDeltaDecoder::Decode(const uint8_t* data, size_t size)
+{
+    if (size == 0 || data[0] > FRAMEDELTA_KEYFRAME)
+        return false;
+
+    bool keyframe = data[0] == FRAMEDELTA_KEYFRAME;
+    if (!keyframe && !m_valid)
+        return false;
+
+    // Work on a copy, so a malformed frame leaves the screen as it was.
+    uint8_t screen[CHIP8_PACKED_SCREEN_SIZE];
+    if (keyframe)
+        memset(screen, 0, sizeof(screen));
+    else
+        memcpy(screen, m_packed, sizeof(screen));
+
+    size_t pos = 1, i = 0;
+    while (pos < size)
+    {
+        if (size - pos < 2)
+            return false;
+        size_t zeros = data[pos], literals = data[pos + 1];
+        pos += 2;
+
+        if (size - pos < literals || CHIP8_PACKED_SCREEN_SIZE - i < zeros + literals)
+            return false;
+
+        i += zeros;
+        for (size_t k = 0; k < literals; k++)
+            screen[i + k] ^= data[pos + k];
+        i += literals;
+        pos += literals;
+    }
+
+    memcpy(m_packed, screen, sizeof(m_packed));
+    m_valid = true;
+    return true;
+};
+
+bool FrameDeltaDecoder::Valid() const
+{
+    return m_valid;
+};
+
+const uint8_t* FrameDeltaDecoder::Packed() const
+{
+    return m_packed;
+};
+
+void FrameDeltaDecoder::Unpack(uint8_t* screen) const
+{
+    for (size_t b = 0; b < CHIP8_PACKED_SCREEN_SIZE; b++)
+        for (unsigned int bit = 0; bit < 8; bit++)
+            screen[b * 8 + bit] = (m_packed[b] >> (7 - bit)) & 1;
+};
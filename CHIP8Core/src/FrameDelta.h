@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CHIP8.h"
+
+// Frames between two keyframes, 2 s at 60 Hz. 0 only sends the first one.
+#define FRAMEDELTA_KEYFRAME_INTERVAL 120
+// Upper bound of one encoded frame : flag byte, then at most one 2 bytes chunk header per screen byte.
+#define FRAMEDELTA_MAX_SIZE (1 + 3 * CHIP8_PACKED_SCREEN_SIZE)
+
+#define FRAMEDELTA_DELTA 0
+#define FRAMEDELTA_KEYFRAME 1
+
+/* Frame delta codec
+* Compresses a stream of bit-packed screens (CHIP8::PackScreen()) for remote viewers.
+*
+* Every frame is XORed with the previous one, so only flipped pixels are non-zero, and the result is
+* run-length encoded as chunks of (uint8 zero bytes, uint8 literal bytes, literals). Trailing zero bytes are
+* not sent at all : an unchanged screen costs 1 byte, a moving sprite usually a few.
+* A keyframe is the same encoding against a blank screen, sent first and then every keyframe_interval frames,
+* so a decoder which missed or rejected something is back in sync after at most one interval.
+*/
+class FrameDeltaEncoder
+{
+public:
+    explicit FrameDeltaEncoder(unsigned int keyframe_interval = FRAMEDELTA_KEYFRAME_INTERVAL);
+
+    // Append the encoding of packed to out. Return true when it is a keyframe.
+    bool Encode(const uint8_t* packed, std::vector<uint8_t>& out);
+
+    // Make the next frame a keyframe.
+    void ForceKeyframe();
+private:
+    uint8_t         m_previous[CHIP8_PACKED_SCREEN_SIZE];
+    unsigned int    m_interval;
+    // Frames encoded since the last keyframe.
+    unsigned int    m_since;
+    bool            m_keyframe;
+};
+
+class FrameDeltaDecoder
+{
+public:
+    FrameDeltaDecoder();
+
+    // Apply one encoded frame. Return false, and keep the current screen, when data is malformed
+    // or is a delta while no keyframe was decoded yet.
+    bool Decode(const uint8_t* data, size_t size);
+
+    // True once a keyframe was decoded.
+    bool Valid() const;
+
+    // Current screen, CHIP8_PACKED_SCREEN_SIZE bytes.
+    const uint8_t* Packed() const;
+
+    // Expand the current screen to one byte per pixel, 0 or 1, like CHIP8::Screen().
+    void Unpack(uint8_t* screen) const;
+private:
+    uint8_t         m_packed[CHIP8_PACKED_SCREEN_SIZE];
+    bool            m_valid;
+};
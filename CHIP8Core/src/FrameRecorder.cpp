@@ -0,0 +1,219 @@
+#include "FrameRecorder.h"
+
+#include <chrono>
+#include <cstring>
+
+#define RECORDER_FILE_BUFFER (1 << 20)
+// Longest gap which Y4M gap filling repeats the previous frame for (one minute).
+#define RECORDER_MAX_REPEAT 3600
+
+static void PutU16(FILE* file, uint16_t v)
+{
+    uint8_t b[2] = { static_cast<uint8_t>(v), static_cast<uint8_t>(v >> 8) };
+    fwrite(b, 1, sizeof(b), file);
+}
+
+static void PutU64(FILE* file, uint64_t v)
+{
+    uint8_t b[8];
+    for (int i = 0; i < 8; i++)
+        b[i] = static_cast<uint8_t>(v >> (8 * i));
+    fwrite(b, 1, sizeof(b), file);
+}
+
+FrameRecorder::FrameRecorder(const std::string& filepath, Format format, unsigned int scale, unsigned int capacity)
+    : m_file(nullptr), m_format(format), m_scale(scale ? scale : 1), m_ring(capacity ? capacity : 1),
+      m_head(0), m_tail(0), m_dropped(0), m_written(0), m_stop(false),
+      m_has_last(false), m_last_frame(0), m_last_screen(CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT)
+{
+    m_file = fopen(filepath.c_str(), "wb");
+    if (m_file == nullptr)
+        return;
+
+    setvbuf(m_file, nullptr, _IOFBF, RECORDER_FILE_BUFFER);
+    m_plane.resize(CHIP8_SCREEN_WIDTH * m_scale * CHIP8_SCREEN_HEIGHT * m_scale);
+    _writeHeader();
+
+    m_thread = std::thread(&FrameRecorder::_writer, this);
+};
+
+FrameRecorder::~FrameRecorder()
+{
+    if (m_file == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop.store(true, std::memory_order_release);
+    }
+    m_wake.notify_one();
+    m_thread.join();
+
+    fclose(m_file);
+};
+
+bool FrameRecorder::IsOpen() const
+{
+    return m_file != nullptr;
+};
+
+bool FrameRecorder::Push(const uint8_t* screen, uint64_t frame)
+{
+    if (m_file == nullptr)
+        return false;
+
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= m_ring.size())
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Slot& slot = m_ring[head % m_ring.size()];
+    slot.frame = frame;
+    memcpy(slot.screen, screen, sizeof(slot.screen));
+
+    m_head.store(head + 1, std::memory_order_release);
+    // No lock here : a missed wake-up only delays the writer until its next timeout.
+    m_wake.notify_one();
+    return true;
+};
+
+bool FrameRecorder::Full() const
+{
+    return m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire) >= m_ring.size();
+};
+
+uint64_t FrameRecorder::Dropped() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+};
+
+uint64_t FrameRecorder::Written() const
+{
+    return m_written.load(std::memory_order_relaxed);
+};
+
+FrameRecorder::Format FrameRecorder::FormatFromPath(const std::string& filepath)
+{
+    size_t dot = filepath.find_last_of('.');
+    if (dot != std::string::npos && filepath.substr(dot + 1) == "y4m")
+        return FORMAT_Y4M;
+    return FORMAT_RLE;
+};
+
+void FrameRecorder::_writer()
+{
+    while (true)
+    {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail == m_head.load(std::memory_order_acquire))
+        {
+            if (m_stop.load(std::memory_order_acquire))
+            {
+                // The producer is gone once stop is set, so one last check drains everything.
+                if (tail == m_head.load(std::memory_order_acquire))
+                    break;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(10));
+            continue;
+        }
+
+        const Slot& slot = m_ring[tail % m_ring.size()];
+
+        if (m_format == FORMAT_Y4M)
+        {
+            // Repeat the previous frame over gaps, so the 60 fps timeline matches emulated time.
+            if (m_has_last && slot.frame > m_last_frame + 1)
+            {
+                uint64_t repeat = slot.frame - m_last_frame - 1;
+                if (repeat > RECORDER_MAX_REPEAT) repeat = RECORDER_MAX_REPEAT;
+                for (uint64_t r = 0; r < repeat; r++)
+                    _writeY4M(m_last_screen.data());
+            }
+            _writeY4M(slot.screen);
+
+            memcpy(m_last_screen.data(), slot.screen, m_last_screen.size());
+            m_last_frame = slot.frame;
+            m_has_last = true;
+        }
+        else
+        {
+            _writeRLE(slot);
+        }
+
+        m_written.fetch_add(1, std::memory_order_relaxed);
+        m_tail.store(tail + 1, std::memory_order_release);
+    }
+
+    fflush(m_file);
+};
+
+void FrameRecorder::_writeHeader()
+{
+    if (m_format == FORMAT_Y4M)
+    {
+        fprintf(m_file, "YUV4MPEG2 W%u H%u F60:1 Ip A1:1 C420jpeg\n",
+            CHIP8_SCREEN_WIDTH * m_scale, CHIP8_SCREEN_HEIGHT * m_scale);
+    }
+    else
+    {
+        fwrite("CH8RLE1\n", 1, 8, m_file);
+        PutU16(m_file, CHIP8_SCREEN_WIDTH);
+        PutU16(m_file, CHIP8_SCREEN_HEIGHT);
+    }
+};
+
+void FrameRecorder::_writeY4M(const uint8_t* screen)
+{
+    unsigned int w = CHIP8_SCREEN_WIDTH * m_scale;
+    unsigned int h = CHIP8_SCREEN_HEIGHT * m_scale;
+
+    // Luma plane : white for lit pixels, black otherwise, each pixel repeated scale times.
+    for (unsigned int y = 0; y < h; y++)
+    {
+        const uint8_t* row = screen + (y / m_scale) * CHIP8_SCREEN_WIDTH;
+        uint8_t* out = m_plane.data() + y * w;
+        for (unsigned int x = 0; x < w; x++)
+            out[x] = row[x / m_scale] ? 0xFF : 0x00;
+    }
+
+    fwrite("FRAME\n", 1, 6, m_file);
+    fwrite(m_plane.data(), 1, w * h, m_file);
+
+    // Neutral chroma planes, quarter size each for 4:2:0.
+    size_t chroma = static_cast<size_t>((w + 1) / 2) * ((h + 1) / 2);
+    memset(m_plane.data(), 0x80, chroma);
+    fwrite(m_plane.data(), 1, chroma, m_file);
+    fwrite(m_plane.data(), 1, chroma, m_file);
+};
+
+void FrameRecorder::_writeRLE(const Slot& slot)
+{
+    uint16_t runs[CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT + 1];
+    uint16_t count = 0;
+    uint16_t length = 0;
+    uint8_t current = 0;
+
+    for (unsigned int i = 0; i < CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT; i++)
+    {
+        uint8_t pixel = slot.screen[i] ? 1 : 0;
+        if (pixel != current)
+        {
+            runs[count++] = length;
+            length = 0;
+            current = pixel;
+        }
+        length++;
+    }
+    runs[count++] = length;
+
+    PutU64(m_file, slot.frame);
+    PutU16(m_file, count);
+    for (uint16_t i = 0; i < count; i++)
+        PutU16(m_file, runs[i]);
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CHIP8.h"
+
+/* Frame recorder
+* Captures screens into a single-producer / single-consumer ring. A background thread
+* drains the ring into a file, so the emulation thread never blocks on disk I/O.
+* When the writer falls behind and the ring is full, the frame is dropped and counted.
+*
+* Formats :
+*   FORMAT_Y4M : uncompressed YUV4MPEG2, 60 fps, C420jpeg, every pixel scaled up by scale.
+*                Gaps in the frame numbers repeat the previous frame, so playback keeps emulated time.
+*   FORMAT_RLE : "CH8RLE1\n", uint16 width, uint16 height, then per frame :
+*                uint64 frame number, uint16 run count, run count * uint16 run lengths.
+*                Runs alternate between 0 and 1 pixels, starting with 0. All integers little-endian.
+*/
+class FrameRecorder
+{
+public:
+    enum Format : uint8_t
+    {
+        FORMAT_Y4M = 0,
+        FORMAT_RLE
+    };
+
+    FrameRecorder(const std::string& filepath, Format format, unsigned int scale = 1, unsigned int capacity = 256);
+    // Drain the ring and close the file.
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    bool IsOpen() const;
+
+    // Queue a 64*32 screen captured at frame. Never blocks. Return false when the frame is dropped.
+    bool Push(const uint8_t* screen, uint64_t frame);
+
+    // True while Push() would drop. Callers without a real-time deadline can wait on this instead.
+    bool Full() const;
+
+    uint64_t Dropped() const;
+    uint64_t Written() const;
+
+    // FORMAT_Y4M for *.y4m, FORMAT_RLE otherwise.
+    static Format FormatFromPath(const std::string& filepath);
+private:
+    struct Slot
+    {
+        uint64_t frame;
+        uint8_t screen[CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT];
+    };
+
+    void _writer();
+    void _writeHeader();
+    void _writeY4M(const uint8_t* screen);
+    void _writeRLE(const Slot& slot);
+private:
+    FILE                    *m_file;
+    Format                  m_format;
+    unsigned int            m_scale;
+
+    std::vector<Slot>       m_ring;
+    // head is only written by the producer, tail only by the writer thread.
+    alignas(64) std::atomic<uint64_t> m_head;
+    alignas(64) std::atomic<uint64_t> m_tail;
+
+    std::atomic<uint64_t>   m_dropped;
+    std::atomic<uint64_t>   m_written;
+    std::atomic<bool>       m_stop;
+
+    // Y4M gap filling.
+    bool                    m_has_last;
+    uint64_t                m_last_frame;
+    std::vector<uint8_t>    m_last_screen;
+    std::vector<uint8_t>    m_plane;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    std::thread             m_thread;
+};
@@ -0,0 +1,362 @@
+#include "FramebufferConverter.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define FRAMEBUFFER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 for functions which ask for it, so the rest of the core keeps the baseline ISA.
+// MSVC accepts the intrinsics anywhere.
+#if defined(__GNUC__)
+#define FRAMEBUFFER_AVX2 __attribute__((target("avx2")))
+#else
+#define FRAMEBUFFER_AVX2
+#endif
+
+/* Scalar kernels
+* Reference implementation, and the only one on non x86 hosts.
+*/
+static void ExpandBytesScalar(const uint8_t* src, uint32_t* out, uint32_t off, uint32_t on)
+{
+    for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x++)
+        out[x] = src[x] ? on : off;
+}
+
+static void ExpandPackedScalar(const uint8_t* src, uint32_t* out, uint32_t off, uint32_t on)
+{
+    for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x++)
+        out[x] = (src[x >> 3] & (0x80 >> (x & 0x7))) ? on : off;
+}
+
+static void WidenScalar(const uint32_t* in, uint32_t* out, unsigned int scale)
+{
+    for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x++)
+        for (unsigned int s = 0; s < scale; s++)
+            *out++ = in[x];
+}
+
+#ifdef FRAMEBUFFER_X86
+/* SSE2 kernels
+* Part of the x86_64 baseline, so always available there.
+* Pixels are selected as (off & mask) | (on & ~mask) with mask set where the pixel is off.
+*/
+static inline __m128i SelectSSE2(__m128i off_mask, __m128i off, __m128i on)
+{
+    return _mm_or_si128(_mm_and_si128(off_mask, off), _mm_andnot_si128(off_mask, on));
+}
+
+static void ExpandBytesSSE2(const uint8_t* src, uint32_t* out, uint32_t off, uint32_t on)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i off_v = _mm_set1_epi32(static_cast<int>(off));
+    const __m128i on_v = _mm_set1_epi32(static_cast<int>(on));
+
+    for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x += 16)
+    {
+        // 16 byte masks, widened to 32 bits by duplicating each byte twice.
+        __m128i m8 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)), zero);
+        __m128i m16_lo = _mm_unpacklo_epi8(m8, m8);
+        __m128i m16_hi = _mm_unpackhi_epi8(m8, m8);
+
+        __m128i* dst = reinterpret_cast<__m128i*>(out + x);
+        _mm_storeu_si128(dst + 0, SelectSSE2(_mm_unpacklo_epi16(m16_lo, m16_lo), off_v, on_v));
+        _mm_storeu_si128(dst + 1, SelectSSE2(_mm_unpackhi_epi16(m16_lo, m16_lo), off_v, on_v));
+        _mm_storeu_si128(dst + 2, SelectSSE2(_mm_unpacklo_epi16(m16_hi, m16_hi), off_v, on_v));
+        _mm_storeu_si128(dst + 3, SelectSSE2(_mm_unpackhi_epi16(m16_hi, m16_hi), off_v, on_v));
+    }
+}
+
+static void ExpandPackedSSE2(const uint8_t* src, uint32_t* out, uint32_t off, uint32_t on)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i off_v = _mm_set1_epi32(static_cast<int>(off));
+    const __m128i on_v = _mm_set1_epi32(static_cast<int>(on));
+    // Lane 0 is the leftmost pixel, which is the most significant bit.
+    const __m128i bits_lo = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+    const __m128i bits_hi = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+
+    for (unsigned int b = 0; b < FRAMEBUFFER_PACKED_PITCH; b++)
+    {
+        __m128i v = _mm_set1_epi32(src[b]);
+
+        __m128i* dst = reinterpret_cast<__m128i*>(out + b * 8);
+        _mm_storeu_si128(dst + 0, SelectSSE2(_mm_cmpeq_epi32(_mm_and_si128(v, bits_lo), zero), off_v, on_v));
+        _mm_storeu_si128(dst + 1, SelectSSE2(_mm_cmpeq_epi32(_mm_and_si128(v, bits_hi), zero), off_v, on_v));
+    }
+}
+
+static void WidenSSE2(const uint32_t* in, uint32_t* out, unsigned int scale)
+{
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+
+    if (scale == 2)
+    {
+        for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x += 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x));
+            _mm_storeu_si128(dst++, _mm_unpacklo_epi32(v, v));
+            _mm_storeu_si128(dst++, _mm_unpackhi_epi32(v, v));
+        }
+    }
+    else if (scale == 4)
+    {
+        for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x += 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x));
+            _mm_storeu_si128(dst++, _mm_shuffle_epi32(v, 0x00));
+            _mm_storeu_si128(dst++, _mm_shuffle_epi32(v, 0x55));
+            _mm_storeu_si128(dst++, _mm_shuffle_epi32(v, 0xAA));
+            _mm_storeu_si128(dst++, _mm_shuffle_epi32(v, 0xFF));
+        }
+    }
+    else
+    {
+        // 8 and 16 : every pixel fills whole vectors.
+        for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x++)
+        {
+            __m128i v = _mm_set1_epi32(static_cast<int>(in[x]));
+            for (unsigned int s = 0; s < scale; s += 4)
+                _mm_storeu_si128(dst++, v);
+        }
+    }
+}
+
+/* AVX2 kernels
+* Eight pixels per vector. Masks come from sign-extending byte compares, so the select is one blend.
+*/
+FRAMEBUFFER_AVX2 static void ExpandBytesAVX2(const uint8_t* src, uint32_t* out, uint32_t off, uint32_t on)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m256i off_v = _mm256_set1_epi32(static_cast<int>(off));
+    const __m256i on_v = _mm256_set1_epi32(static_cast<int>(on));
+
+    for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x += 8)
+    {
+        __m128i m8 = _mm_cmpeq_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + x)), zero);
+        __m256i m = _mm256_cvtepi8_epi32(m8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_blendv_epi8(on_v, off_v, m));
+    }
+}
+
+FRAMEBUFFER_AVX2 static void ExpandPackedAVX2(const uint8_t* src, uint32_t* out, uint32_t off, uint32_t on)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i off_v = _mm256_set1_epi32(static_cast<int>(off));
+    const __m256i on_v = _mm256_set1_epi32(static_cast<int>(on));
+    const __m256i bits = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+    for (unsigned int b = 0; b < FRAMEBUFFER_PACKED_PITCH; b++)
+    {
+        __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(src[b]), bits), zero);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + b * 8), _mm256_blendv_epi8(on_v, off_v, m));
+    }
+}
+
+FRAMEBUFFER_AVX2 static void WidenAVX2(const uint32_t* in, uint32_t* out, unsigned int scale)
+{
+    __m256i* dst = reinterpret_cast<__m256i*>(out);
+
+    if (scale == 2)
+    {
+        const __m256i lo = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+        const __m256i hi = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+
+        for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x += 8)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x));
+            _mm256_storeu_si256(dst++, _mm256_permutevar8x32_epi32(v, lo));
+            _mm256_storeu_si256(dst++, _mm256_permutevar8x32_epi32(v, hi));
+        }
+    }
+    else if (scale == 4)
+    {
+        const __m256i idx0 = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+        const __m256i step = _mm256_set1_epi32(2);
+
+        for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x += 8)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x));
+            __m256i idx = idx0;
+            for (unsigned int q = 0; q < 4; q++)
+            {
+                _mm256_storeu_si256(dst++, _mm256_permutevar8x32_epi32(v, idx));
+                idx = _mm256_add_epi32(idx, step);
+            }
+        }
+    }
+    else
+    {
+        // 8 and 16 : every pixel fills whole vectors.
+        for (unsigned int x = 0; x < CHIP8_SCREEN_WIDTH; x++)
+        {
+            __m256i v = _mm256_set1_epi32(static_cast<int>(in[x]));
+            for (unsigned int s = 0; s < scale; s += 8)
+                _mm256_storeu_si256(dst++, v);
+        }
+    }
+}
+
+static bool CpuHasAVX2()
+{
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // The OS has to save the YMM registers too (OSXSAVE, then XCR0 bits 1 and 2).
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+#endif
+
+FramebufferConverter::FramebufferConverter(uint32_t off, uint32_t on, unsigned int scale, Kernel kernel)
+    : m_off(off), m_on(on), m_scale(1), m_kernel(KERNEL_SCALAR),
+      m_expand_bytes(ExpandBytesScalar), m_expand_packed(ExpandPackedScalar), m_widen(WidenScalar)
+{
+    SetScale(scale);
+
+    if (kernel == KERNEL_AUTO || !Supported(kernel))
+        kernel = BestKernel();
+
+#ifdef FRAMEBUFFER_X86
+    if (kernel == KERNEL_AVX2)
+    {
+        m_expand_bytes = ExpandBytesAVX2;
+        m_expand_packed = ExpandPackedAVX2;
+        m_widen = WidenAVX2;
+    }
+    else if (kernel == KERNEL_SSE2)
+    {
+        m_expand_bytes = ExpandBytesSSE2;
+        m_expand_packed = ExpandPackedSSE2;
+        m_widen = WidenSSE2;
+    }
+#endif
+    m_kernel = kernel;
+};
+
+void FramebufferConverter::SetPalette(uint32_t off, uint32_t on)
+{
+    m_off = off;
+    m_on = on;
+};
+
+bool FramebufferConverter::SetScale(unsigned int scale)
+{
+    if (scale == 0 || scale > FRAMEBUFFER_MAX_SCALE || (scale & (scale - 1)) != 0)
+        return false;
+
+    m_scale = scale;
+    return true;
+};
+
+unsigned int FramebufferConverter::Scale() const
+{
+    return m_scale;
+};
+
+FramebufferConverter::Kernel FramebufferConverter::ActiveKernel() const
+{
+    return m_kernel;
+};
+
+void FramebufferConverter::ConvertBytes(const uint8_t* screen, unsigned int first_row, unsigned int rows, void* dst, int pitch) const
+{
+    _convert(m_expand_bytes, screen, CHIP8_SCREEN_WIDTH, first_row, rows, dst, pitch);
+};
+
+void FramebufferConverter::ConvertPacked(const uint8_t* packed, unsigned int first_row, unsigned int rows, void* dst, int pitch) const
+{
+    _convert(m_expand_packed, packed, FRAMEBUFFER_PACKED_PITCH, first_row, rows, dst, pitch);
+};
+
+bool FramebufferConverter::Supported(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case KERNEL_AUTO:
+    case KERNEL_SCALAR:
+        return true;
+#ifdef FRAMEBUFFER_X86
+    case KERNEL_SSE2:
+        return true;
+    case KERNEL_AVX2:
+    {
+        static const bool avx2 = CpuHasAVX2();
+        return avx2;
+    }
+#endif
+    default:
+        return false;
+    }
+};
+
+FramebufferConverter::Kernel FramebufferConverter::BestKernel()
+{
+    if (Supported(KERNEL_AVX2))
+        return KERNEL_AVX2;
+    if (Supported(KERNEL_SSE2))
+        return KERNEL_SSE2;
+    return KERNEL_SCALAR;
+};
+
+const char* FramebufferConverter::KernelName(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case KERNEL_AUTO:   return "auto";
+    case KERNEL_SCALAR: return "scalar";
+    case KERNEL_SSE2:   return "sse2";
+    case KERNEL_AVX2:   return "avx2";
+    default:            return "unknown";
+    }
+};
+
+void FramebufferConverter::_convert(expand_fun expand, const uint8_t* src, unsigned int src_pitch,
+                                    unsigned int first_row, unsigned int rows, void* dst, int pitch) const
+{
+    if (first_row >= CHIP8_SCREEN_HEIGHT)
+        return;
+    if (rows > CHIP8_SCREEN_HEIGHT - first_row)
+        rows = CHIP8_SCREEN_HEIGHT - first_row;
+
+    uint8_t* line = static_cast<uint8_t*>(dst);
+    size_t line_bytes = static_cast<size_t>(CHIP8_SCREEN_WIDTH) * m_scale * sizeof(uint32_t);
+    uint32_t base[CHIP8_SCREEN_WIDTH];
+
+    for (unsigned int r = first_row; r < first_row + rows; r++)
+    {
+        const uint8_t* row = src + r * src_pitch;
+
+        if (m_scale == 1)
+        {
+            expand(row, reinterpret_cast<uint32_t*>(line), m_off, m_on);
+            line += pitch;
+            continue;
+        }
+
+        expand(row, base, m_off, m_on);
+        m_widen(base, reinterpret_cast<uint32_t*>(line), m_scale);
+
+        // Vertical scaling repeats the finished line.
+        for (unsigned int s = 1; s < m_scale; s++)
+            memcpy(line + s * pitch, line, line_bytes);
+        line += static_cast<size_t>(m_scale) * pitch;
+    }
+};
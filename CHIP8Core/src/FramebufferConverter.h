@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CHIP8.h"
+
+// Bytes per row of a bit-packed screen, leftmost pixel in the most significant bit (VecEnv::OBS_PACKED).
+#define FRAMEBUFFER_PACKED_PITCH (CHIP8_SCREEN_WIDTH / 8)
+#define FRAMEBUFFER_MAX_SCALE 16
+
+/* Framebuffer converter
+* Expands a 64*32 CHIP-8 screen into ARGB8888 with a two-color palette,
+* optionally scaled up by an integer factor for software renderers and recordings.
+*
+* Sources :
+*   Bytes  : one byte per pixel, zero is off (CHIP8::Screen()).
+*   Packed : one bit per pixel, FRAMEBUFFER_PACKED_PITCH bytes per row.
+*
+* The kernel is picked once at construction from what the CPU supports :
+* AVX2, then SSE2, then a portable scalar loop. All kernels produce identical output.
+*/
+class FramebufferConverter
+{
+public:
+    enum Kernel : uint8_t
+    {
+        KERNEL_AUTO = 0,    // Best kernel the CPU supports.
+        KERNEL_SCALAR,
+        KERNEL_SSE2,
+        KERNEL_AVX2
+    };
+
+    // Black and white at scale 1 by default, which is what Window shows.
+    // A kernel the CPU does not support falls back to the best supported one.
+    FramebufferConverter(uint32_t off = 0xFF000000, uint32_t on = 0xFFFFFFFF, unsigned int scale = 1,
+                         Kernel kernel = KERNEL_AUTO);
+
+    void SetPalette(uint32_t off, uint32_t on);
+
+    // Only 1, 2, 4, 8 and 16 are supported. Return false and keep the old scale otherwise.
+    bool SetScale(unsigned int scale);
+    unsigned int Scale() const;
+
+    Kernel ActiveKernel() const;
+
+    // Convert rows [first_row, first_row + rows) of the source screen.
+    // dst receives rows * scale lines of CHIP8_SCREEN_WIDTH * scale pixels, pitch bytes apart.
+    void ConvertBytes(const uint8_t* screen, unsigned int first_row, unsigned int rows, void* dst, int pitch) const;
+    void ConvertPacked(const uint8_t* packed, unsigned int first_row, unsigned int rows, void* dst, int pitch) const;
+
+    static bool Supported(Kernel kernel);
+    static Kernel BestKernel();
+    static const char* KernelName(Kernel kernel);
+private:
+    typedef void (*expand_fun)(const uint8_t* src, uint32_t* out, uint32_t off, uint32_t on);
+    typedef void (*widen_fun)(const uint32_t* in, uint32_t* out, unsigned int scale);
+
+    void _convert(expand_fun expand, const uint8_t* src, unsigned int src_pitch,
+                  unsigned int first_row, unsigned int rows, void* dst, int pitch) const;
+private:
+    uint32_t        m_off;
+    uint32_t        m_on;
+    unsigned int    m_scale;
+    Kernel          m_kernel;
+
+    // Expand one source row into CHIP8_SCREEN_WIDTH pixels, then repeat every pixel scale times.
+    expand_fun      m_expand_bytes;
+    expand_fun      m_expand_packed;
+    widen_fun       m_widen;
+};
@@ -0,0 +1,242 @@
+#include "NetTransport.h"
+
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define NET_TRANSPORT_POSIX 1
+#endif
+
+// Split spec at ':' into at most max_fields fields, the last one keeps any further ':'.
+static std::vector<std::string> SplitSpec(const std::string& spec, size_t max_fields)
+{
+    std::vector<std::string> fields;
+    size_t start = 0;
+
+    while (fields.size() + 1 < max_fields)
+    {
+        size_t colon = spec.find(':', start);
+        if (colon == std::string::npos)
+            break;
+        fields.push_back(spec.substr(start, colon - start));
+        start = colon + 1;
+    }
+    fields.push_back(spec.substr(start));
+    return fields;
+}
+
+#ifdef NET_TRANSPORT_POSIX
+// Remove path only if it is a socket, so a mistyped path never deletes a regular file.
+static void UnlinkSocket(const std::string& path)
+{
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path.c_str());
+}
+#endif
+
+SocketTransport::SocketTransport(const std::string& spec)
+    : m_fd(-1)
+{
+    std::vector<std::string> fields = SplitSpec(spec, 4);
+
+    bool opened = false;
+    if (fields.size() == 4 && fields[0] == "udp")
+        opened = _openUdp(fields[1], fields[2], fields[3]);
+    else if (fields.size() == 3 && fields[0] == "unix")
+        opened = _openUnix(fields[1], fields[2]);
+
+    if (!opened)
+        _close();
+};
+
+SocketTransport::~SocketTransport()
+{
+    _close();
+};
+
+bool SocketTransport::IsOpen() const
+{
+    return m_fd >= 0;
+};
+
+bool SocketTransport::Send(const void* data, size_t size)
+{
+#ifdef NET_TRANSPORT_POSIX
+    if (m_fd < 0)
+        return false;
+
+    ssize_t sent = m_remote.empty()
+        ? send(m_fd, data, size, 0)
+        : sendto(m_fd, data, size, 0, reinterpret_cast<const sockaddr*>(m_remote.data()), static_cast<socklen_t>(m_remote.size()));
+    return sent == static_cast<ssize_t>(size);
+#else
+    return false;
+#endif
+};
+
+size_t SocketTransport::Receive(void* data, size_t capacity)
+{
+#ifdef NET_TRANSPORT_POSIX
+    if (m_fd < 0)
+        return 0;
+
+    // Nothing waiting (EAGAIN), or the peer is not up yet (ECONNREFUSED on UDP), both read as no datagram.
+    ssize_t got = recv(m_fd, data, capacity, 0);
+    return got > 0 ? static_cast<size_t>(got) : 0;
+#else
+    return 0;
+#endif
+};
+
+bool SocketTransport::_openUdp(const std::string& local_port, const std::string& host, const std::string& remote_port)
+{
+#ifdef NET_TRANSPORT_POSIX
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo* remote = nullptr;
+    if (getaddrinfo(host.c_str(), remote_port.c_str(), &hints, &remote) != 0)
+        return false;
+
+    // Bind the local port on the same address family as the peer.
+    hints.ai_family = remote->ai_family;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* local = nullptr;
+    bool ok = getaddrinfo(nullptr, local_port.c_str(), &hints, &local) == 0;
+
+    if (ok)
+    {
+        m_fd = socket(remote->ai_family, SOCK_DGRAM, 0);
+        ok = m_fd >= 0 &&
+             bind(m_fd, local->ai_addr, local->ai_addrlen) == 0 &&
+             connect(m_fd, remote->ai_addr, remote->ai_addrlen) == 0 &&
+             fcntl(m_fd, F_SETFL, O_NONBLOCK) == 0;
+        freeaddrinfo(local);
+    }
+
+    freeaddrinfo(remote);
+    return ok;
+#else
+    return false;
+#endif
+};
+
+bool SocketTransport::_openUnix(const std::string& local_path, const std::string& remote_path)
+{
+#ifdef NET_TRANSPORT_POSIX
+    sockaddr_un local, remote;
+    if (local_path.empty() || remote_path.empty() ||
+        local_path.size() >= sizeof(local.sun_path) || remote_path.size() >= sizeof(remote.sun_path))
+        return false;
+
+    memset(&local, 0, sizeof(local));
+    local.sun_family = AF_UNIX;
+    strcpy(local.sun_path, local_path.c_str());
+
+    memset(&remote, 0, sizeof(remote));
+    remote.sun_family = AF_UNIX;
+    strcpy(remote.sun_path, remote_path.c_str());
+
+    m_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (m_fd < 0)
+        return false;
+
+    // A previous run which did not exit cleanly leaves its socket file behind.
+    UnlinkSocket(local_path);
+    if (bind(m_fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0)
+        return false;
+    m_unix_path = local_path;
+
+    // Connecting fails until the peer has bound its path, so address every datagram instead.
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&remote);
+    m_remote.assign(bytes, bytes + sizeof(remote));
+    return fcntl(m_fd, F_SETFL, O_NONBLOCK) == 0;
+#else
+    return false;
+#endif
+};
+
+void SocketTransport::_close()
+{
+#ifdef NET_TRANSPORT_POSIX
+    if (m_fd >= 0)
+        close(m_fd);
+    if (!m_unix_path.empty())
+        UnlinkSocket(m_unix_path);
+#endif
+    m_fd = -1;
+    m_unix_path.clear();
+    m_remote.clear();
+};
+
+LossyTransport::LossyTransport(NetTransport& inner, unsigned int latency_ms, unsigned int jitter_ms, double loss, uint32_t seed)
+    : m_inner(inner), m_latency_ms(latency_ms), m_jitter_ms(jitter_ms), m_loss(loss),
+      m_rng_state(seed ? seed : 0x9E3779B9u), m_dropped(0)
+{
+};
+
+bool LossyTransport::Send(const void* data, size_t size)
+{
+    _pump();
+
+    // 24 random bits are plenty for a percentage.
+    if (m_loss > 0.0 && (_random() >> 8) < m_loss * (1u << 24))
+    {
+        m_dropped++;
+        return true;
+    }
+
+    unsigned int delay = m_latency_ms + (m_jitter_ms ? _random() % (m_jitter_ms + 1) : 0);
+    if (delay == 0)
+        return m_inner.Send(data, size);
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    m_held.push_back({ std::chrono::steady_clock::now() + std::chrono::milliseconds(delay),
+                       std::vector<uint8_t>(bytes, bytes + size) });
+    return true;
+};
+
+size_t LossyTransport::Receive(void* data, size_t capacity)
+{
+    _pump();
+    return m_inner.Receive(data, capacity);
+};
+
+uint64_t LossyTransport::Dropped() const
+{
+    return m_dropped;
+};
+
+void LossyTransport::_pump()
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // Only a handful of datagrams are held at a time, so a linear scan is enough.
+    for (size_t i = 0; i < m_held.size();)
+    {
+        if (m_held[i].due <= now)
+        {
+            m_inner.Send(m_held[i].data.data(), m_held[i].data.size());
+            m_held.erase(m_held.begin() + i);
+        }
+        else
+            i++;
+    }
+};
+
+uint32_t LossyTransport::_random()
+{
+    // Same xorshift as CXNN.
+    m_rng_state ^= m_rng_state << 13;
+    m_rng_state ^= m_rng_state >> 17;
+    m_rng_state ^= m_rng_state << 5;
+    return m_rng_state;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Largest datagram a transport carries.
+#define NET_MAX_DATAGRAM 1024
+
+/* Net transport
+* Unreliable, unordered datagrams between exactly two peers, the way UDP behaves.
+* Netplay only talks through this interface, so sockets can be swapped for a simulated link.
+* Neither call ever blocks.
+*/
+class NetTransport
+{
+public:
+    virtual ~NetTransport() {};
+
+    // Queue one datagram for the peer. Return false when it could not be sent, which is the same as losing it.
+    virtual bool Send(const void* data, size_t size) = 0;
+
+    // Copy the next datagram from the peer into data. Return its size, 0 when nothing is waiting.
+    virtual size_t Receive(void* data, size_t capacity) = 0;
+};
+
+/* Socket transport
+* Non-blocking datagram socket, set up from a spec :
+*   udp:<local port>:<remote host>:<remote port>
+*   unix:<local path>:<remote path>     (Unix domain datagram socket, both ends on one host)
+* Only available on POSIX systems, IsOpen() stays false elsewhere.
+*/
+class SocketTransport : public NetTransport
+{
+public:
+    explicit SocketTransport(const std::string& spec);
+    ~SocketTransport();
+
+    SocketTransport(const SocketTransport&) = delete;
+    SocketTransport& operator=(const SocketTransport&) = delete;
+
+    bool IsOpen() const;
+
+    bool Send(const void* data, size_t size) override;
+    size_t Receive(void* data, size_t capacity) override;
+private:
+    bool _openUdp(const std::string& local_port, const std::string& host, const std::string& remote_port);
+    bool _openUnix(const std::string& local_path, const std::string& remote_path);
+    void _close();
+private:
+    int             m_fd;
+    // Bound Unix socket path, unlinked on destruction.
+    std::string     m_unix_path;
+    // Raw peer address for sendto(), empty when the socket is connected.
+    std::vector<uint8_t> m_remote;
+};
+
+/* Lossy transport
+* Wraps another transport and degrades what it sends : every datagram is dropped with probability loss,
+* or held back for latency_ms plus up to jitter_ms, which also reorders datagrams.
+* Used to try rollback on one host over loopback. Held datagrams go out on later Send() / Receive() calls.
+*/
+class LossyTransport : public NetTransport
+{
+public:
+    LossyTransport(NetTransport& inner, unsigned int latency_ms, unsigned int jitter_ms = 0, double loss = 0.0,
+                   uint32_t seed = 0x9E3779B9u);
+
+    bool Send(const void* data, size_t size) override;
+    size_t Receive(void* data, size_t capacity) override;
+
+    uint64_t Dropped() const;
+private:
+    struct Held
+    {
+        std::chrono::steady_clock::time_point due;
+        std::vector<uint8_t> data;
+    };
+
+    // Send every held datagram which is due.
+    void _pump();
+    uint32_t _random();
+private:
+    NetTransport        &m_inner;
+    unsigned int        m_latency_ms;
+    unsigned int        m_jitter_ms;
+    double              m_loss;
+    uint32_t            m_rng_state;
+
+    std::vector<Held>   m_held;
+    uint64_t            m_dropped;
+};
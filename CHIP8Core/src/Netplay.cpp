@@ -0,0 +1,260 @@
+#include "Netplay.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define NETPLAY_MAGIC 0x504E3843u   // "C8NP"
+// Frame field of a datagram without a state hash.
+#define NETPLAY_NO_FRAME 0xFFFFFFFFu
+// magic, first input frame, ack, hash frame, hash, input count.
+#define NETPLAY_HEADER_SIZE (4 + 4 + 4 + 4 + 8 + 1)
+#define NETPLAY_STATES (NETPLAY_MAX_ROLLBACK + 1)
+
+/* Datagram layout, little endian :
+*   uint32 magic
+*   uint32 first    : frame of the first input below, the oldest one the peer has not acknowledged.
+*   uint32 ack      : remote inputs of frames [0, ack) are known to the sender.
+*   uint32 frame    : frame of the state hash below, NETPLAY_NO_FRAME when there is none yet.
+*   uint64 hash
+*   uint8  count
+*   uint16 inputs[count]
+* Frames are sent as 32 bits, which lasts more than two years at 60 frames per second.
+*/
+static void Put(uint8_t*& out, uint64_t v, unsigned int bytes)
+{
+    for (unsigned int i = 0; i < bytes; i++)
+        *out++ = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static uint64_t Get(const uint8_t*& in, unsigned int bytes)
+{
+    uint64_t v = 0;
+    for (unsigned int i = 0; i < bytes; i++)
+        v |= static_cast<uint64_t>(*in++) << (8 * i);
+    return v;
+}
+
+NetplaySession::NetplaySession(CHIP8& chip8, NetTransport& transport)
+    : m_chip8(chip8), m_transport(transport), m_frame(0), m_confirmed(0), m_acked(0), m_rollback_from(UINT64_MAX),
+      m_check_next(0), m_check_frame(NETPLAY_NO_FRAME), m_check_hash(0), m_desynced(false),
+      m_rollbacks(0), m_resimulated(0), m_stalls(0)
+{
+    memset(m_local, 0, sizeof(m_local));
+    memset(m_remote, 0, sizeof(m_remote));
+    memset(m_used, 0, sizeof(m_used));
+
+    for (unsigned int i = 0; i < NETPLAY_INPUT_WINDOW; i++)
+    {
+        m_local_frames[i] = m_remote_frames[i] = UINT64_MAX;
+        m_local_hashes[i] = m_remote_hashes[i] = 0;
+    }
+};
+
+void NetplaySession::Poll()
+{
+    uint8_t data[NET_MAX_DATAGRAM];
+    size_t size;
+    while ((size = m_transport.Receive(data, sizeof(data))) > 0)
+        _receive(data, size);
+
+    if (m_rollback_from < m_frame)
+        _rollback(m_rollback_from);
+    m_rollback_from = UINT64_MAX;
+
+    _check();
+    _send();
+};
+
+bool NetplaySession::AdvanceFrame(uint16_t local_keys)
+{
+    Poll();
+
+    if (m_frame >= m_confirmed + NETPLAY_MAX_ROLLBACK)
+    {
+        m_stalls++;
+        return false;
+    }
+
+    m_local[m_frame % NETPLAY_INPUT_WINDOW] = local_keys;
+    _run(m_frame);
+    m_frame++;
+
+    // Send the new input right away instead of on the next Poll().
+    _send();
+    return true;
+};
+
+uint64_t NetplaySession::Frame() const
+{
+    return m_frame;
+};
+
+uint64_t NetplaySession::ConfirmedFrames() const
+{
+    return m_confirmed;
+};
+
+bool NetplaySession::Settled() const
+{
+    return m_confirmed >= m_frame && m_acked >= m_frame;
+};
+
+bool NetplaySession::Desynced() const
+{
+    return m_desynced;
+};
+
+uint64_t NetplaySession::Rollbacks() const
+{
+    return m_rollbacks;
+};
+
+uint64_t NetplaySession::ResimulatedFrames() const
+{
+    return m_resimulated;
+};
+
+uint64_t NetplaySession::Stalls() const
+{
+    return m_stalls;
+};
+
+void NetplaySession::_receive(const uint8_t* data, size_t size)
+{
+    if (size < NETPLAY_HEADER_SIZE)
+        return;
+
+    const uint8_t* in = data;
+    if (Get(in, 4) != NETPLAY_MAGIC)
+        return;
+
+    uint64_t first = Get(in, 4);
+    uint64_t ack = Get(in, 4);
+    uint64_t check_frame = Get(in, 4);
+    uint64_t check_hash = Get(in, 8);
+    unsigned int count = static_cast<unsigned int>(Get(in, 1));
+    if (size < NETPLAY_HEADER_SIZE + 2 * count)
+        return;
+
+    // Datagrams arrive out of order, so only ever move forward.
+    if (ack > m_acked)
+        m_acked = std::min(ack, m_frame);
+
+    if (check_frame != NETPLAY_NO_FRAME)
+    {
+        unsigned int slot = (check_frame / NETPLAY_CHECK_INTERVAL) % NETPLAY_INPUT_WINDOW;
+        m_remote_frames[slot] = check_frame;
+        m_remote_hashes[slot] = check_hash;
+        _compare(slot);
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint64_t frame = first + i;
+        uint16_t input = static_cast<uint16_t>(Get(in, 2));
+
+        // Already known. A gap cannot happen since the peer always starts at our ack, but never trust it.
+        if (frame < m_confirmed)
+            continue;
+        if (frame > m_confirmed || frame + NETPLAY_STATES >= m_frame + NETPLAY_INPUT_WINDOW)
+            break;
+
+        m_remote[frame % NETPLAY_INPUT_WINDOW] = input;
+        m_confirmed++;
+
+        if (frame < m_frame && m_used[frame % NETPLAY_INPUT_WINDOW] != input)
+            m_rollback_from = std::min(m_rollback_from, frame);
+    }
+};
+
+void NetplaySession::_rollback(uint64_t frame)
+{
+    // Frames before m_frame - NETPLAY_MAX_ROLLBACK were never run unconfirmed, so their state is still saved.
+    m_chip8.Restore(m_states[frame % NETPLAY_STATES]);
+
+    for (uint64_t f = frame; f < m_frame; f++)
+        _run(f);
+
+    m_rollbacks++;
+    m_resimulated += m_frame - frame;
+};
+
+void NetplaySession::_run(uint64_t frame)
+{
+    m_chip8.Snapshot(m_states[frame % NETPLAY_STATES]);
+
+    uint16_t remote = _remoteInput(frame);
+    m_used[frame % NETPLAY_INPUT_WINDOW] = remote;
+
+    uint16_t keys = m_local[frame % NETPLAY_INPUT_WINDOW] | remote;
+    for (uint8_t k = 0; k < CHIP8_KEY_SIZE; k++)
+        m_chip8.SetKey(k, (keys >> k) & 1);
+
+    // A fault stops both machines on the same frame, the caller sees it in CHIP8::Fault().
+    m_chip8.RunFrame();
+};
+
+void NetplaySession::_check()
+{
+    // The state before frame f is final once the inputs of every frame before it are known.
+    uint64_t final_frame = std::min(m_confirmed, m_frame);
+
+    for (; m_check_next <= final_frame; m_check_next++)
+    {
+        uint64_t frame = m_check_next;
+        if (frame % NETPLAY_CHECK_INTERVAL != 0)
+            continue;
+
+        uint64_t hash;
+        if (frame == m_frame)
+            hash = m_chip8.Hash();
+        else
+        {
+            m_scratch.Restore(m_states[frame % NETPLAY_STATES]);
+            hash = m_scratch.Hash();
+        }
+
+        unsigned int slot = (frame / NETPLAY_CHECK_INTERVAL) % NETPLAY_INPUT_WINDOW;
+        m_local_frames[slot] = frame;
+        m_local_hashes[slot] = hash;
+        m_check_frame = frame;
+        m_check_hash = hash;
+        _compare(slot);
+    }
+};
+
+void NetplaySession::_compare(unsigned int slot)
+{
+    if (m_local_frames[slot] != UINT64_MAX && m_local_frames[slot] == m_remote_frames[slot] &&
+        m_local_hashes[slot] != m_remote_hashes[slot])
+        m_desynced = true;
+};
+
+void NetplaySession::_send()
+{
+    uint8_t data[NETPLAY_HEADER_SIZE + 2 * NETPLAY_INPUT_WINDOW];
+    uint8_t* out = data;
+
+    uint64_t count = std::min<uint64_t>(m_frame - m_acked, NETPLAY_INPUT_WINDOW);
+    uint64_t first = m_frame - count;
+
+    Put(out, NETPLAY_MAGIC, 4);
+    Put(out, first, 4);
+    Put(out, m_confirmed, 4);
+    Put(out, m_check_frame, 4);
+    Put(out, m_check_hash, 8);
+    Put(out, count, 1);
+    for (uint64_t f = first; f < m_frame; f++)
+        Put(out, m_local[f % NETPLAY_INPUT_WINDOW], 2);
+
+    m_transport.Send(data, out - data);
+};
+
+uint16_t NetplaySession::_remoteInput(uint64_t frame) const
+{
+    if (frame < m_confirmed)
+        return m_remote[frame % NETPLAY_INPUT_WINDOW];
+
+    // Players hold keys for many frames, so the last known keys are the best guess.
+    return m_confirmed > 0 ? m_remote[(m_confirmed - 1) % NETPLAY_INPUT_WINDOW] : 0;
+};
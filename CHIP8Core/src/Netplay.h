@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CHIP8.h"
+#include "NetTransport.h"
+
+// Frames a side may run ahead of the last remote input it has. Further frames stall until input arrives.
+#define NETPLAY_MAX_ROLLBACK 8
+// Inputs kept per side, indexed by frame modulo. Covers the rollback window of both sides with room to spare.
+#define NETPLAY_INPUT_WINDOW 64
+// Frames between two state hashes compared with the peer.
+#define NETPLAY_CHECK_INTERVAL 16
+
+/* Netplay session
+* Two processes play the same ROM on one shared keypad, GGPO style : each side runs its frames right away
+* with the remote keys predicted to be the last ones it received, and saves the machine state before every frame.
+* When remote input for a past frame arrives and differs from the prediction, the machine is restored to that
+* frame and the frames since are run again with the corrected input. Both keypads are ORed together,
+* so for PONG one player uses 1 / 4 and the other C / D.
+*
+* Every datagram carries all local inputs the peer has not acknowledged yet, so a lost datagram is covered
+* by the next one and no retransmission is needed. Both sides hash the machine state every
+* NETPLAY_CHECK_INTERVAL frames once it is final and compare the hashes, which also catches different ROMs.
+*
+* Both sides must load the same ROM with the same seed and start from a fresh machine.
+*/
+class NetplaySession
+{
+public:
+    NetplaySession(CHIP8& chip8, NetTransport& transport);
+
+    // Handle the datagrams which arrived, roll back if a prediction was wrong, and send the unacknowledged inputs.
+    void Poll();
+
+    // Poll(), then run the next frame with local_keys as a mask, bit k for key k.
+    // Return false without running it while NETPLAY_MAX_ROLLBACK frames are still unconfirmed.
+    bool AdvanceFrame(uint16_t local_keys);
+
+    // Frames run so far, and frames for which the remote input is known.
+    uint64_t Frame() const;
+    uint64_t ConfirmedFrames() const;
+
+    // Both sides have every input of the frames run so far.
+    bool Settled() const;
+
+    // A state hash of the peer differs from ours for the same frame.
+    bool Desynced() const;
+
+    uint64_t Rollbacks() const;
+    uint64_t ResimulatedFrames() const;
+    // Calls to AdvanceFrame() which returned false.
+    uint64_t Stalls() const;
+private:
+    void _receive(const uint8_t* data, size_t size);
+    void _rollback(uint64_t frame);
+    // Run frame with the local input and the known or predicted remote input, saving the state before it.
+    void _run(uint64_t frame);
+    // Hash the states which became final, every NETPLAY_CHECK_INTERVAL frames.
+    void _check();
+    void _compare(unsigned int slot);
+    void _send();
+    uint16_t _remoteInput(uint64_t frame) const;
+private:
+    CHIP8           &m_chip8;
+    NetTransport    &m_transport;
+
+    uint64_t        m_frame;
+    // Remote inputs of frames [0, m_confirmed) are known, local inputs of frames [0, m_acked) reached the peer.
+    uint64_t        m_confirmed;
+    uint64_t        m_acked;
+    // Earliest frame run with a wrong prediction, UINT64_MAX when there is none.
+    uint64_t        m_rollback_from;
+
+    uint16_t        m_local[NETPLAY_INPUT_WINDOW];
+    uint16_t        m_remote[NETPLAY_INPUT_WINDOW];
+    // Remote input each frame was last run with.
+    uint16_t        m_used[NETPLAY_INPUT_WINDOW];
+
+    // State before frame f at f % (NETPLAY_MAX_ROLLBACK + 1).
+    CHIP8State      m_states[NETPLAY_MAX_ROLLBACK + 1];
+
+    // Next frame to consider for a hash, and hashes of both sides per check slot.
+    uint64_t        m_check_next;
+    uint64_t        m_check_frame, m_check_hash;
+    uint64_t        m_local_frames[NETPLAY_INPUT_WINDOW], m_local_hashes[NETPLAY_INPUT_WINDOW];
+    uint64_t        m_remote_frames[NETPLAY_INPUT_WINDOW], m_remote_hashes[NETPLAY_INPUT_WINDOW];
+    bool            m_desynced;
+    // Restored from saved states to hash them.
+    CHIP8           m_scratch;
+
+    uint64_t        m_rollbacks;
+    uint64_t        m_resimulated;
+    uint64_t        m_stalls;
+};
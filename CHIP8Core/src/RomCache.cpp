@@ -0,0 +1,172 @@
+#include "RomCache.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <sys/stat.h>
+
+// Modification and status change times in nanoseconds, so two writes within one second are told apart.
+#if defined(__APPLE__)
+#define ROM_CACHE_NS(ts) (static_cast<int64_t>((ts).tv_sec) * 1000000000 + (ts).tv_nsec)
+#define ROM_CACHE_MTIME(info) ROM_CACHE_NS((info).st_mtimespec)
+#define ROM_CACHE_CTIME(info) ROM_CACHE_NS((info).st_ctimespec)
+#elif defined(__unix__)
+#define ROM_CACHE_NS(ts) (static_cast<int64_t>((ts).tv_sec) * 1000000000 + (ts).tv_nsec)
+#define ROM_CACHE_MTIME(info) ROM_CACHE_NS((info).st_mtim)
+#define ROM_CACHE_CTIME(info) ROM_CACHE_NS((info).st_ctim)
+#else
+#define ROM_CACHE_MTIME(info) (static_cast<int64_t>((info).st_mtime) * 1000000000)
+#define ROM_CACHE_CTIME(info) (static_cast<int64_t>((info).st_ctime) * 1000000000)
+#endif
+
+RomCache& RomCache::Instance()
+{
+    static RomCache cache;
+    return cache;
+};
+
+RomCache::RomCache()
+    : m_hits(0), m_misses(0)
+{
+};
+
+const RomImage* RomCache::Get(const std::string& filepath, CHIP8Fault& fault)
+{
+    // One stat() per load decides whether the cached image is still the file's content.
+    struct stat info;
+    if (stat(filepath.c_str(), &info) != 0)
+    {
+        fault = CHIP8Fault::ROM_NOT_FOUND;
+        return nullptr;
+    }
+
+    uint64_t size = static_cast<uint64_t>(info.st_size);
+    int64_t mtime = ROM_CACHE_MTIME(info);
+    // The modification time can be set back, e.g. by cp -p, but that moves the status change time.
+    int64_t ctime = ROM_CACHE_CTIME(info);
+    // A file replaced by rename() is a new inode, even when size and times match.
+    uint64_t inode = static_cast<uint64_t>(info.st_ino);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_paths.find(filepath);
+    if (it != m_paths.end() && it->second.size == size && it->second.mtime == mtime &&
+        it->second.ctime == ctime && it->second.inode == inode)
+    {
+        m_hits++;
+        fault = CHIP8Fault::NONE;
+        return it->second.image;
+    }
+    m_misses++;
+
+    if (size > CHIP8_MEMORY_SIZE - 0x200)
+    {
+        fault = CHIP8Fault::ROM_TOO_LARGE;
+        return nullptr;
+    }
+
+    FILE* file = fopen(filepath.c_str(), "rb");
+    if (file == nullptr)
+    {
+        fault = CHIP8Fault::ROM_NOT_FOUND;
+        return nullptr;
+    }
+
+    // Read one byte more than expected, to notice a file which grew since stat().
+    uint8_t buffer[CHIP8_MEMORY_SIZE - 0x200 + 1];
+    size_t read = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+
+    if (read > CHIP8_MEMORY_SIZE - 0x200)
+    {
+        fault = CHIP8Fault::ROM_TOO_LARGE;
+        return nullptr;
+    }
+
+    // A file which changed between stat() and fread() is read again next time.
+    const RomImage* image = _insert(buffer, read);
+    m_paths[filepath] = { read == size ? size : ~0ull, mtime, ctime, inode, image };
+
+    fault = CHIP8Fault::NONE;
+    return image;
+};
+
+const RomImage* RomCache::Find(uint64_t hash) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_images.find(hash);
+    return it != m_images.end() ? &it->second->image : nullptr;
+};
+
+size_t RomCache::Images() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_images.size();
+};
+
+uint64_t RomCache::Hits() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+};
+
+uint64_t RomCache::Misses() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+};
+
+uint64_t RomCache::HashBytes(const uint8_t* data, size_t size)
+{
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    uint64_t h = prime ^ size;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ word) * prime;
+        h ^= h >> 29;
+    }
+
+    uint64_t tail = 0;
+    if (i < size)
+        memcpy(&tail, data + i, size - i);
+    h = (h ^ tail) * prime;
+
+    // Final avalanche, so every input bit reaches the low bits the hash map uses.
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    return h;
+};
+
+const RomImage* RomCache::_insert(const uint8_t* data, size_t size)
+{
+    uint64_t hash = HashBytes(data, size);
+
+    // Probe past a colliding hash, so two different ROMs never share an image.
+    while (true)
+    {
+        auto it = m_images.find(hash);
+        if (it == m_images.end())
+            break;
+
+        const RomImage& image = it->second->image;
+        if (image.size == size && memcmp(image.data, data, size) == 0)
+            return &image;
+        hash++;
+    }
+
+    std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+    entry->bytes.assign(data, data + size);
+    entry->power_on = std::make_unique<CHIP8>();
+    entry->power_on->_flash(data, size);
+    entry->image = { hash, entry->bytes.data(), size, entry->power_on.get() };
+
+    const RomImage* image = &entry->image;
+    m_images[hash] = std::move(entry);
+    return image;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CHIP8.h"
+
+// Pristine program bytes of one ROM, loaded at 0x200, and the machine right after loading it.
+struct RomImage
+{
+    uint64_t hash;
+    const uint8_t* data;
+    size_t size;
+    const CHIP8* power_on;
+};
+
+/* ROM cache
+* Process-wide cache of ROM files, so loading the same ROM again is a single bulk copy of its power-on
+* machine instead of opening, reading and freeing the file every time. CHIP8::Load() goes through it, and
+* CHIP8::Reset() copies the same power-on machine. CHIP8::LoadBytes() does not : bytes handed over by the
+* C ABI, Python or chip8d are often generated, and would pile up here until exit.
+*
+* Images are indexed by content hash : files with the same bytes share one image. Paths are only a shortcut
+* to the hash, checked against the file size, inode and nanosecond modification and status change times on
+* every Get(), so a ROM edited or replaced on disk is read again. Images are never evicted and never change,
+* a pointer returned once stays valid until exit. Only ROM files are cached and they are at most 3.5 KB,
+* so the cache stays small even with thousands of them.
+*
+* The ROM is read into memory owned by the cache rather than kept mapped : a mapping would turn a later
+* truncation of the file into SIGBUS inside Load(). All methods are thread-safe.
+*/
+class RomCache
+{
+public:
+    static RomCache& Instance();
+
+    RomCache(const RomCache&) = delete;
+    RomCache& operator=(const RomCache&) = delete;
+
+    // Image of the file at filepath, read on first use or when the file changed.
+    // Return nullptr and set fault to ROM_NOT_FOUND or ROM_TOO_LARGE on failure.
+    const RomImage* Get(const std::string& filepath, CHIP8Fault& fault);
+
+    // Cached image with this content hash, nullptr when there is none.
+    const RomImage* Find(uint64_t hash) const;
+
+    size_t Images() const;
+    // Get() calls answered without reading the file, and calls which had to read it.
+    uint64_t Hits() const;
+    uint64_t Misses() const;
+
+    // 64 bits content hash, 8 bytes per step.
+    // Only meant for this process : the value depends on the byte order.
+    static uint64_t HashBytes(const uint8_t* data, size_t size);
+private:
+    RomCache();
+
+    // Image of these bytes, copied into the cache unless identical bytes are cached already.
+    // The caller holds m_mutex and checked the size.
+    const RomImage* _insert(const uint8_t* data, size_t size);
+private:
+    struct Entry
+    {
+        RomImage image;
+        std::vector<uint8_t> bytes;
+        std::unique_ptr<CHIP8> power_on;
+    };
+
+    // What the file looked like when its image was read.
+    struct PathEntry
+    {
+        uint64_t size;
+        // Nanoseconds since the epoch.
+        int64_t mtime;
+        int64_t ctime;
+        uint64_t inode;
+        const RomImage* image;
+    };
+
+    mutable std::mutex      m_mutex;
+    std::unordered_map<uint64_t, std::unique_ptr<Entry>> m_images;
+    std::unordered_map<std::string, PathEntry> m_paths;
+
+    uint64_t                m_hits;
+    uint64_t                m_misses;
+};
@@ -0,0 +1,81 @@
+#include "RunAhead.h"
+
+#include <cstring>
+
+RunAhead::RunAhead(unsigned int frames_ahead)
+    : m_frames_ahead(1), m_dirty_rows(CHIP8_ALL_ROWS), m_predictions(0), m_overhead(0)
+{
+    SetFramesAhead(frames_ahead);
+    memset(m_screen, 0, sizeof(m_screen));
+};
+
+bool RunAhead::SetFramesAhead(unsigned int frames_ahead)
+{
+    if (frames_ahead == 0 || frames_ahead > RUNAHEAD_MAX_FRAMES)
+        return false;
+
+    m_frames_ahead = frames_ahead;
+    return true;
+};
+
+unsigned int RunAhead::FramesAhead() const
+{
+    return m_frames_ahead;
+};
+
+void RunAhead::Predict(CHIP8& chip8)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    chip8.Snapshot(m_state);
+
+    // A fault while predicting only ends the prediction early, the real machine reports it when it gets there.
+    for (unsigned int f = 0; f < m_frames_ahead; f++)
+        if (chip8.RunFrame().fault != CHIP8Fault::NONE)
+            break;
+
+    // Compare row by row, the restore below marks every row of chip8 dirty.
+    const uint8_t* screen = chip8.Screen();
+    for (unsigned int y = 0; y < CHIP8_SCREEN_HEIGHT; y++)
+    {
+        const uint8_t* row = screen + y * CHIP8_SCREEN_WIDTH;
+        uint8_t* shown = m_screen + y * CHIP8_SCREEN_WIDTH;
+
+        if (memcmp(shown, row, CHIP8_SCREEN_WIDTH) != 0)
+        {
+            memcpy(shown, row, CHIP8_SCREEN_WIDTH);
+            m_dirty_rows |= 1u << y;
+        }
+    }
+
+    // The snapshot was taken from a running machine, whose stack pointer never leaves range,
+    // so it always passes the check of Restore().
+    chip8.Restore(m_state);
+
+    m_overhead += std::chrono::steady_clock::now() - start;
+    m_predictions++;
+};
+
+const uint8_t* RunAhead::Screen() const
+{
+    return m_screen;
+};
+
+uint32_t RunAhead::TakeDirtyRows()
+{
+    uint32_t rows = m_dirty_rows;
+    m_dirty_rows = 0;
+    return rows;
+};
+
+uint64_t RunAhead::Predictions() const
+{
+    return m_predictions;
+};
+
+double RunAhead::OverheadMicroseconds() const
+{
+    if (m_predictions == 0)
+        return 0.0;
+    return std::chrono::duration<double, std::micro>(m_overhead).count() / m_predictions;
+};
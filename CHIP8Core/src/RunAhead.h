@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "CHIP8.h"
+
+// Most frames a prediction may run ahead. Every frame ahead costs one more emulated frame per host frame.
+#define RUNAHEAD_MAX_FRAMES 8
+
+/* Run-ahead
+* Hides the input lag a ROM has internally, e.g. polling keys on one frame and drawing the result a few frames later.
+*
+* After every real frame, Predict() snapshots the machine, runs it frames_ahead more frames with the keys held now,
+* keeps the screen it ends up with and restores the snapshot. The predicted screen is shown instead of the real one,
+* so a key press shows up frames_ahead frames earlier. The real machine is left exactly as it was,
+* apart from its dirty rows which are all set by the restore.
+*
+* The cost of the snapshot, the predicted frames and the restore is measured on every call.
+*/
+class RunAhead
+{
+public:
+    explicit RunAhead(unsigned int frames_ahead = 1);
+
+    // Only 1 to RUNAHEAD_MAX_FRAMES. Return false and keep the old value otherwise.
+    bool SetFramesAhead(unsigned int frames_ahead);
+    unsigned int FramesAhead() const;
+
+    // Predict the screen frames_ahead frames after the current state of chip8, then roll chip8 back.
+    void Predict(CHIP8& chip8);
+
+    // Screen of the last prediction, one byte per pixel like CHIP8::Screen().
+    const uint8_t* Screen() const;
+
+    // Rows of Screen() changed by the predictions since the last call, bit y for row y.
+    uint32_t TakeDirtyRows();
+
+    // Predictions made so far, and their average cost in microseconds.
+    uint64_t Predictions() const;
+    double OverheadMicroseconds() const;
+private:
+    unsigned int    m_frames_ahead;
+    CHIP8State      m_state;
+
+    uint8_t         m_screen[CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT];
+    uint32_t        m_dirty_rows;
+
+    uint64_t        m_predictions;
+    std::chrono::steady_clock::duration m_overhead;
+};
@@ -0,0 +1,146 @@
+#include "SessionClient.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SESSION_CLIENT_POSIX 1
+#endif
+
+#define SESSION_CLIENT_READ_SIZE (64 * 1024)
+
+SessionClient::SessionClient(const std::string& path)
+    : m_fd(-1), m_consumed(0)
+{
+#ifdef SESSION_CLIENT_POSIX
+    sockaddr_un addr;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_fd >= 0 && connect(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+};
+
+SessionClient::~SessionClient()
+{
+#ifdef SESSION_CLIENT_POSIX
+    if (m_fd >= 0)
+        close(m_fd);
+#endif
+};
+
+bool SessionClient::IsOpen() const
+{
+    return m_fd >= 0;
+};
+
+void SessionClient::Request(SessionCommand command, uint32_t session, const void* payload, size_t size)
+{
+    SessionPut(m_out, 1 + 4 + size, 4);
+    SessionPut(m_out, static_cast<uint8_t>(command), 1);
+    SessionPut(m_out, session, 4);
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+    m_out.insert(m_out.end(), bytes, bytes + size);
+};
+
+bool SessionClient::Flush()
+{
+#ifdef SESSION_CLIENT_POSIX
+    // poll() ignores a negative descriptor and would wait forever.
+    if (!IsOpen())
+        return false;
+
+    size_t sent = 0;
+
+    while (sent < m_out.size())
+    {
+        pollfd pfd = { m_fd, POLLIN | POLLOUT, 0 };
+        if (poll(&pfd, 1, -1) < 0)
+            return false;
+
+        // The server stops reading while its responses pile up, so take them in before writing more.
+        if ((pfd.revents & POLLIN) && !_read())
+            return false;
+
+        if (pfd.revents & POLLOUT)
+        {
+            ssize_t n = send(m_fd, m_out.data() + sent, m_out.size() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                return false;
+            if (n > 0)
+                sent += n;
+        }
+
+        if (pfd.revents & (POLLERR | POLLHUP))
+            return false;
+    }
+
+    m_out.clear();
+    return true;
+#else
+    return false;
+#endif
+};
+
+bool SessionClient::Receive(SessionResponse& response)
+{
+    while (true)
+    {
+        size_t available = m_in.size() - m_consumed;
+        if (available >= 4)
+        {
+            const uint8_t* head = m_in.data() + m_consumed;
+            uint32_t length = static_cast<uint32_t>(SessionGet(head, 4));
+
+            if (length < SESSION_RESPONSE_HEADER_SIZE - 4)
+                return false;
+
+            if (available >= 4 + length)
+            {
+                response.status = static_cast<SessionStatus>(head[4]);
+                response.command = static_cast<SessionCommand>(head[5]);
+                response.session = static_cast<uint32_t>(SessionGet(head + 6, 4));
+                response.payload.assign(head + SESSION_RESPONSE_HEADER_SIZE, head + 4 + length);
+                m_consumed += 4 + length;
+                return true;
+            }
+        }
+
+        if (!_read())
+            return false;
+    }
+};
+
+bool SessionClient::_read()
+{
+#ifdef SESSION_CLIENT_POSIX
+    // Drop what was handed out already before the buffer grows.
+    if (m_consumed > 0)
+    {
+        m_in.erase(m_in.begin(), m_in.begin() + m_consumed);
+        m_consumed = 0;
+    }
+
+    size_t size = m_in.size();
+    m_in.resize(size + SESSION_CLIENT_READ_SIZE);
+    ssize_t n = recv(m_fd, m_in.data() + size, SESSION_CLIENT_READ_SIZE, 0);
+    m_in.resize(size + (n > 0 ? n : 0));
+    return n > 0;
+#else
+    return false;
+#endif
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SessionProtocol.h"
+
+/* Session client
+* Blocking client of the chip8d session server, for harnesses and viewers.
+*
+* Requests are queued locally and only go out on Flush(), so a batch of requests costs one write.
+* Responses come back in request order through Receive(). While Flush() waits for the socket to drain
+* it keeps reading responses, so a batch of any size cannot deadlock against the server's output.
+* Only available on POSIX systems, IsOpen() stays false elsewhere.
+*/
+class SessionClient
+{
+public:
+    explicit SessionClient(const std::string& path);
+    ~SessionClient();
+
+    SessionClient(const SessionClient&) = delete;
+    SessionClient& operator=(const SessionClient&) = delete;
+
+    bool IsOpen() const;
+
+    // Queue one request.
+    void Request(SessionCommand command, uint32_t session, const void* payload = nullptr, size_t size = 0);
+
+    // Send every queued request. Return false when the connection is gone.
+    bool Flush();
+
+    // Wait for the next response. Return false when the connection is gone.
+    bool Receive(SessionResponse& response);
+private:
+    // Read whatever the server sent into m_in. Return false when the connection is gone.
+    bool _read();
+private:
+    int                     m_fd;
+
+    std::vector<uint8_t>    m_out;
+    std::vector<uint8_t>    m_in;
+    // Bytes of m_in already handed out by Receive().
+    size_t                  m_consumed;
+};
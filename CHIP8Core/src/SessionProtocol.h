@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CHIP8.h"
+
+#define SESSION_PROTOCOL_VERSION 2
+
+// Request : uint32 length, uint8 command, uint32 session. Response : uint32 length, uint8 status, uint8 command, uint32 session.
+// length counts the bytes after the length field itself.
+#define SESSION_REQUEST_HEADER_SIZE (4 + 1 + 4)
+#define SESSION_RESPONSE_HEADER_SIZE (4 + 1 + 1 + 4)
+// Largest request, a LOAD with a ROM filling all the memory above 0x200.
+#define SESSION_MAX_REQUEST (SESSION_REQUEST_HEADER_SIZE + CHIP8_MEMORY_SIZE - 0x200)
+// Saved states per session, see SNAPSHOT and RESTORE.
+#define SESSION_SNAPSHOT_SLOTS 8
+// Most frames one STEP may run, so one request cannot hold up every other client for long.
+#define SESSION_MAX_STEP 3600
+
+/* Session protocol
+* Compact binary protocol of the chip8d session server, over a Unix stream socket. All integers are little endian.
+*
+* A client may send any number of requests without waiting, the server answers every request with exactly one
+* response, in request order. Requests which arrive together are executed together and their responses
+* go back in as few writes as possible, so batching thousands of requests costs a few system calls.
+*
+* Sessions are visible to every client, but they belong to the client which created them
+* and are destroyed when that client disconnects.
+*
+* Command      Request payload             Response payload (status OK)
+*   CREATE     uint32 seed (0 : default)   none, the new session id is in the header
+*   DESTROY    none                        none
+*   LOAD       ROM bytes                   none. LOAD_FAILED carries uint8 CHIP8Fault
+*   SET_KEYS   uint16 mask, bit k = key k  none
+*   STEP       uint32 frames               uint8 CHIP8Fault, uint16 pc, uint16 opcode (first fault, or NONE)
+*   GET_FRAME  none                        CHIP8_PACKED_SCREEN_SIZE bytes, see CHIP8::PackScreen()
+*   SNAPSHOT   uint8 slot                  none
+*   RESTORE    uint8 slot                  none
+*   HASH       none                        uint64 CHIP8::Hash()
+*   VERSION    none                        uint32 SESSION_PROTOCOL_VERSION
+*   LIST       none                        uint32 id of every session, ascending
+*   GET_DELTA  none                        the screen encoded by a FrameDeltaEncoder, see FrameDelta.h
+*
+* GET_DELTA is the frame stream for viewers. The server keeps one encoder per client and session, so
+* a viewer polling its sessions once per frame only receives what changed since its previous poll.
+*/
+enum class SessionCommand : uint8_t
+{
+    CREATE = 1,
+    DESTROY,
+    LOAD,
+    SET_KEYS,
+    STEP,
+    GET_FRAME,
+    SNAPSHOT,
+    RESTORE,
+    HASH,
+    VERSION,
+    LIST,
+    GET_DELTA
+};
+
+enum class SessionStatus : uint8_t
+{
+    OK = 0,
+    UNKNOWN_COMMAND,
+    MALFORMED,          // Payload has the wrong size or an out of range value.
+    NO_SESSION,         // No such session, or it belongs to another client and the command changes it.
+    NO_CAPACITY,        // Every session the server was started with is in use.
+    LOAD_FAILED,
+    NO_SNAPSHOT         // RESTORE from a slot which was never saved.
+};
+
+struct SessionResponse
+{
+    SessionStatus status;
+    SessionCommand command;
+    uint32_t session;
+    std::vector<uint8_t> payload;
+};
+
+// Little endian helpers shared by the server and its clients.
+inline void SessionPut(std::vector<uint8_t>& out, uint64_t v, unsigned int bytes)
+{
+    for (unsigned int i = 0; i < bytes; i++)
+        out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+inline uint64_t SessionGet(const uint8_t* in, unsigned int bytes)
+{
+    uint64_t v = 0;
+    for (unsigned int i = 0; i < bytes; i++)
+        v |= static_cast<uint64_t>(in[i]) << (8 * i);
+    return v;
+}
@@ -0,0 +1,164 @@
+#include "SharedFrame.h"
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define SHARED_FRAME_POSIX 1
+#endif
+
+// POSIX shared-memory names start with a single slash.
+static std::string SegmentName(const std::string& name)
+{
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+SharedFramePublisher::SharedFramePublisher(const std::string& name)
+    : m_name(SegmentName(name)), m_block(nullptr)
+{
+#ifdef SHARED_FRAME_POSIX
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+        return;
+
+    if (ftruncate(fd, sizeof(SharedFrameBlock)) == 0)
+    {
+        void* addr = mmap(nullptr, sizeof(SharedFrameBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            m_block = static_cast<SharedFrameBlock*>(addr);
+            m_block->seq.store(0, std::memory_order_relaxed);
+            memset(&m_block->payload, 0, sizeof(m_block->payload));
+            m_block->version = SHARED_FRAME_VERSION;
+            // Readers check the magic last, so it is only visible once the header is complete.
+            std::atomic_thread_fence(std::memory_order_release);
+            m_block->magic = SHARED_FRAME_MAGIC;
+        }
+    }
+    close(fd);
+
+    if (m_block == nullptr)
+        shm_unlink(m_name.c_str());
+#endif
+};
+
+SharedFramePublisher::~SharedFramePublisher()
+{
+#ifdef SHARED_FRAME_POSIX
+    if (m_block != nullptr)
+    {
+        munmap(m_block, sizeof(SharedFrameBlock));
+        shm_unlink(m_name.c_str());
+    }
+#endif
+};
+
+bool SharedFramePublisher::IsOpen() const
+{
+    return m_block != nullptr;
+};
+
+void SharedFramePublisher::Publish(const CHIP8& chip8, uint64_t frame)
+{
+    if (m_block == nullptr)
+        return;
+
+    // Stage the payload first, so the odd-seq window only covers one copy.
+    SharedFramePayload staged;
+    memset(&staged, 0, sizeof(staged));
+
+    staged.frame = frame;
+    staged.PC = chip8.PC;
+    staged.I = chip8.I;
+    staged.sp = chip8.sp;
+    memcpy(staged.V, chip8.V, sizeof(staged.V));
+    staged.delay_timer = chip8.delay_timer;
+    staged.sound_timer = chip8.sound_timer;
+    staged.key_mask = chip8.keys;
+    memcpy(staged.screen, chip8.screen, sizeof(staged.screen));
+    staged.checksum = SharedFrameReader::Checksum(staged);
+
+    uint32_t seq = m_block->seq.load(std::memory_order_relaxed);
+    m_block->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(&m_block->payload, &staged, sizeof(staged));
+
+    m_block->seq.store(seq + 2, std::memory_order_release);
+};
+
+SharedFrameReader::SharedFrameReader(const std::string& name)
+    : m_block(nullptr)
+{
+#ifdef SHARED_FRAME_POSIX
+    int fd = shm_open(SegmentName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return;
+
+    void* addr = mmap(nullptr, sizeof(SharedFrameBlock), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED)
+        return;
+
+    const SharedFrameBlock* block = static_cast<const SharedFrameBlock*>(addr);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (block->magic != SHARED_FRAME_MAGIC || block->version != SHARED_FRAME_VERSION)
+    {
+        munmap(addr, sizeof(SharedFrameBlock));
+        return;
+    }
+    m_block = block;
+#endif
+};
+
+SharedFrameReader::~SharedFrameReader()
+{
+#ifdef SHARED_FRAME_POSIX
+    if (m_block != nullptr)
+        munmap(const_cast<SharedFrameBlock*>(m_block), sizeof(SharedFrameBlock));
+#endif
+};
+
+bool SharedFrameReader::IsOpen() const
+{
+    return m_block != nullptr;
+};
+
+bool SharedFrameReader::Read(SharedFramePayload& out, unsigned int max_retries) const
+{
+    if (m_block == nullptr)
+        return false;
+
+    for (unsigned int attempt = 0; attempt <= max_retries; attempt++)
+    {
+        uint32_t before = m_block->seq.load(std::memory_order_acquire);
+        // Odd : the publisher is in the middle of a write. Zero : nothing published yet.
+        if ((before & 0x1) || before == 0)
+            continue;
+
+        memcpy(&out, const_cast<const SharedFramePayload*>(&m_block->payload), sizeof(out));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_block->seq.load(std::memory_order_relaxed) == before)
+            return true;
+    }
+
+    return false;
+};
+
+uint32_t SharedFrameReader::Checksum(const SharedFramePayload& payload)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&payload);
+    uint32_t h = 0x811C9DC5u;
+
+    for (size_t i = 0; i < offsetof(SharedFramePayload, checksum); i++)
+    {
+        h ^= bytes[i];
+        h *= 0x01000193u;
+    }
+    return h;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "CHIP8.h"
+
+#define SHARED_FRAME_MAGIC 0x38504843u  // "CHP8"
+#define SHARED_FRAME_VERSION 1
+
+/* Shared frame
+* Live export of one running CHIP8 into a POSIX shared-memory segment (/dev/shm/<name>),
+* so monitoring, recording and ML processes on the same host can read frames without sockets.
+*
+* The segment is guarded by a seqlock : the publisher makes seq odd, writes the payload,
+* then makes seq even again. Readers copy the payload and retry when seq was odd or changed
+* during the copy, so the publisher never waits on a reader.
+*/
+struct SharedFramePayload
+{
+    uint64_t frame;         // Frame counter of the publisher.
+    uint16_t PC, I, sp;
+    uint8_t V[CHIP8_REGISTER_SIZE];
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint16_t key_mask;      // Bit k set when key k is held.
+    uint8_t screen[CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT];
+    uint32_t checksum;      // FNV-1a over everything above, lets readers prove a copy is not torn.
+};
+
+struct SharedFrameBlock
+{
+    uint32_t magic;
+    uint32_t version;
+    alignas(64) std::atomic<uint32_t> seq;
+    alignas(64) SharedFramePayload payload;
+};
+
+// Writer side, owned by the emulator process. Creates and finally unlinks the segment.
+class SharedFramePublisher
+{
+public:
+    explicit SharedFramePublisher(const std::string& name);
+    ~SharedFramePublisher();
+
+    SharedFramePublisher(const SharedFramePublisher&) = delete;
+    SharedFramePublisher& operator=(const SharedFramePublisher&) = delete;
+
+    bool IsOpen() const;
+
+    // Publish the current state of chip8 as frame.
+    void Publish(const CHIP8& chip8, uint64_t frame);
+private:
+    std::string         m_name;
+    SharedFrameBlock    *m_block;
+};
+
+// Reader side, maps the segment read-only.
+class SharedFrameReader
+{
+public:
+    explicit SharedFrameReader(const std::string& name);
+    ~SharedFrameReader();
+
+    SharedFrameReader(const SharedFrameReader&) = delete;
+    SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+
+    bool IsOpen() const;
+
+    // Copy a consistent payload into out. Return false when no consistent copy
+    // could be taken within max_retries, e.g. the publisher has not written yet.
+    bool Read(SharedFramePayload& out, unsigned int max_retries = 1000) const;
+
+    // Checksum a payload the same way the publisher does.
+    static uint32_t Checksum(const SharedFramePayload& payload);
+private:
+    const SharedFrameBlock  *m_block;
+};
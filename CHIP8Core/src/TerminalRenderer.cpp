@@ -0,0 +1,140 @@
+#include "TerminalRenderer.h"
+
+#include <cstdio>
+
+// Unchanged cells shorter than this are re-emitted instead of moving the cursor past them.
+// A cursor move takes up to 8 bytes, a glyph up to 3.
+#define TERMINAL_MAX_SKIP_CELLS 2
+
+TerminalRenderer::TerminalRenderer(Style style, unsigned int max_fps, unsigned int row, unsigned int col)
+    : m_style(style), m_row(row ? row : 1), m_col(col ? col : 1),
+      m_columns(style == STYLE_BRAILLE ? CHIP8_SCREEN_WIDTH / 2 : CHIP8_SCREEN_WIDTH),
+      m_rows(style == STYLE_BRAILLE ? CHIP8_SCREEN_HEIGHT / 4 : CHIP8_SCREEN_HEIGHT / 2),
+      m_interval(max_fps ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / max_fps))
+                         : std::chrono::steady_clock::duration::zero()),
+      m_rendered(false), m_valid(false), m_bytes(0)
+{
+    m_cells.resize(m_columns * m_rows);
+    m_shown.resize(m_columns * m_rows);
+};
+
+unsigned int TerminalRenderer::Columns() const
+{
+    return m_columns;
+};
+
+unsigned int TerminalRenderer::Rows() const
+{
+    return m_rows;
+};
+
+bool TerminalRenderer::Render(const uint8_t* screen, std::string& out)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (m_rendered && now - m_last < m_interval)
+        return false;
+    m_last = now;
+    m_rendered = true;
+
+    _cells(screen);
+
+    size_t before = out.size();
+    char move[32];
+
+    for (unsigned int r = 0; r < m_rows; r++)
+    {
+        const uint8_t* cells = m_cells.data() + r * m_columns;
+        const uint8_t* shown = m_shown.data() + r * m_columns;
+        // Column the cursor sits at after the last glyph of this row, or -1 when it has to be moved.
+        int cursor = -1;
+
+        for (unsigned int c = 0; c < m_columns; c++)
+        {
+            if (m_valid && cells[c] == shown[c])
+                continue;
+
+            if (cursor >= 0 && c - cursor <= TERMINAL_MAX_SKIP_CELLS)
+            {
+                // Cheaper to repeat the few unchanged cells in between.
+                for (unsigned int k = cursor; k < c; k++)
+                    _glyph(cells[k], out);
+            }
+            else
+            {
+                snprintf(move, sizeof(move), "\033[%u;%uH", m_row + r, m_col + c);
+                out += move;
+            }
+
+            _glyph(cells[c], out);
+            cursor = static_cast<int>(c) + 1;
+        }
+    }
+
+    m_shown.swap(m_cells);
+    m_valid = true;
+    m_bytes += out.size() - before;
+    return true;
+};
+
+void TerminalRenderer::Invalidate()
+{
+    m_valid = false;
+};
+
+uint64_t TerminalRenderer::BytesEmitted() const
+{
+    return m_bytes;
+};
+
+void TerminalRenderer::_cells(const uint8_t* screen)
+{
+    if (m_style == STYLE_HALF_BLOCK)
+    {
+        for (unsigned int r = 0; r < m_rows; r++)
+        {
+            const uint8_t* top = screen + (2 * r) * CHIP8_SCREEN_WIDTH;
+            const uint8_t* bottom = top + CHIP8_SCREEN_WIDTH;
+            uint8_t* cells = m_cells.data() + r * m_columns;
+
+            for (unsigned int c = 0; c < m_columns; c++)
+                cells[c] = static_cast<uint8_t>((top[c] ? 0x1 : 0) | (bottom[c] ? 0x2 : 0));
+        }
+        return;
+    }
+
+    // Braille dot numbering : the left column is dots 1, 2, 3, 7 and the right column 4, 5, 6, 8.
+    static const uint8_t dots[4][2] = { { 0x01, 0x08 }, { 0x02, 0x10 }, { 0x04, 0x20 }, { 0x40, 0x80 } };
+
+    for (unsigned int r = 0; r < m_rows; r++)
+    {
+        uint8_t* cells = m_cells.data() + r * m_columns;
+
+        for (unsigned int c = 0; c < m_columns; c++)
+        {
+            uint8_t cell = 0;
+            for (unsigned int y = 0; y < 4; y++)
+            {
+                const uint8_t* row = screen + (4 * r + y) * CHIP8_SCREEN_WIDTH + 2 * c;
+                if (row[0]) cell |= dots[y][0];
+                if (row[1]) cell |= dots[y][1];
+            }
+            cells[c] = cell;
+        }
+    }
+};
+
+void TerminalRenderer::_glyph(uint8_t cell, std::string& out) const
+{
+    if (m_style == STYLE_HALF_BLOCK)
+    {
+        // Space, upper half (U+2580), lower half (U+2584), full block (U+2588).
+        static const char* glyphs[4] = { " ", "\xE2\x96\x80", "\xE2\x96\x84", "\xE2\x96\x88" };
+        out += glyphs[cell & 0x3];
+        return;
+    }
+
+    // U+2800 + dots, encoded as three UTF-8 bytes.
+    out += '\xE2';
+    out += static_cast<char>(0xA0 | (cell >> 6));
+    out += static_cast<char>(0x80 | (cell & 0x3F));
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CHIP8.h"
+
+/* Terminal renderer
+* Draws a 64*32 screen with Unicode characters and ANSI cursor moves, e.g. over SSH.
+*
+* Styles :
+*   STYLE_HALF_BLOCK : 1*2 pixels per cell, 64*16 cells, works with any font.
+*   STYLE_BRAILLE    : 2*4 pixels per cell, 32*8 cells, needs a font with the Braille block.
+*
+* Only cells which changed since the last rendered frame are emitted, and short runs of unchanged
+* cells are re-emitted instead of moving the cursor when that is shorter. Frames arriving faster
+* than max_fps are skipped, so the caller can offer every frame and the newest one wins.
+* Several renderers with different origins can share one terminal.
+*/
+class TerminalRenderer
+{
+public:
+    enum Style : uint8_t
+    {
+        STYLE_HALF_BLOCK = 0,
+        STYLE_BRAILLE
+    };
+
+    // row and col are the 1-based terminal position of the top left cell. max_fps 0 renders every frame.
+    TerminalRenderer(Style style = STYLE_HALF_BLOCK, unsigned int max_fps = 30, unsigned int row = 1, unsigned int col = 1);
+
+    // Size of the drawn area in terminal cells.
+    unsigned int Columns() const;
+    unsigned int Rows() const;
+
+    // Append the escape sequences which turn the last rendered frame into screen.
+    // Return false without touching out when the rate cap skips this frame.
+    bool Render(const uint8_t* screen, std::string& out);
+
+    // Redraw every cell on the next Render(), e.g. after the terminal was cleared.
+    void Invalidate();
+
+    // Bytes appended by Render() so far.
+    uint64_t BytesEmitted() const;
+private:
+    void _cells(const uint8_t* screen);
+    void _glyph(uint8_t cell, std::string& out) const;
+private:
+    Style                   m_style;
+    unsigned int            m_row, m_col;
+    unsigned int            m_columns, m_rows;
+
+    std::chrono::steady_clock::duration     m_interval;
+    std::chrono::steady_clock::time_point   m_last;
+    bool                    m_rendered;
+
+    // One code per cell : 2 bits (top, bottom) for half blocks, 8 dot bits for Braille.
+    std::vector<uint8_t>    m_cells;
+    std::vector<uint8_t>    m_shown;
+    bool                    m_valid;
+
+    uint64_t                m_bytes;
+};
@@ -0,0 +1,182 @@
+#include "VecEnv.h"
+
+#include <algorithm>
+#include <cstring>
+
+VecEnv::VecEnv(unsigned int n, unsigned int frame_skip, unsigned int threads, ObsFormat format)
+    : m_envs(n), m_frame_skip(frame_skip ? frame_skip : 1), m_format(format), m_seed(1),
+      m_job(JOB_STEP), m_actions(nullptr), m_mask(nullptr), m_obs(nullptr), m_faults(nullptr),
+      m_slices(1), m_generation(0), m_pending(0), m_quit(false)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    m_slices = std::min(threads, std::max(1u, n));
+
+    // The calling thread takes the first slice itself, so start one worker less.
+    for (unsigned int i = 1; i < m_slices; i++)
+        m_workers.emplace_back(&VecEnv::_worker, this, i);
+};
+
+VecEnv::~VecEnv()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_start.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+};
+
+CHIP8Fault VecEnv::Load(const std::string& filepath, uint32_t seed)
+{
+    // Read the file once, every instance is a copy of the pristine machine.
+    CHIP8Fault fault = m_initial.Load(filepath);
+    if (fault == CHIP8Fault::NONE)
+        _spread(seed);
+    return fault;
+};
+
+CHIP8Fault VecEnv::LoadBytes(const uint8_t* data, size_t size, uint32_t seed)
+{
+    CHIP8Fault fault = m_initial.LoadBytes(data, size);
+    if (fault == CHIP8Fault::NONE)
+        _spread(seed);
+    return fault;
+};
+
+void VecEnv::_spread(uint32_t seed)
+{
+    m_seed = seed;
+    for (unsigned int i = 0; i < m_envs.size(); i++)
+    {
+        m_envs[i] = m_initial;
+        m_envs[i].Seed(seed + i);
+    }
+};
+
+void VecEnv::Step(const uint16_t* actions, uint8_t* obs, CHIP8Fault* faults)
+{
+    m_actions = actions;
+    m_obs = obs;
+    m_faults = faults;
+    _dispatch(JOB_STEP);
+};
+
+void VecEnv::Reset(const uint8_t* mask, uint8_t* obs)
+{
+    m_mask = mask;
+    m_obs = obs;
+    _dispatch(JOB_RESET);
+};
+
+unsigned int VecEnv::Size() const
+{
+    return static_cast<unsigned int>(m_envs.size());
+};
+
+size_t VecEnv::ObsSize() const
+{
+    return m_format == OBS_PACKED ? VECENV_PACKED_SIZE : CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT;
+};
+
+CHIP8& VecEnv::Instance(unsigned int i)
+{
+    return m_envs[i];
+};
+
+void VecEnv::_run(unsigned int begin, unsigned int end)
+{
+    for (unsigned int i = begin; i < end; i++)
+    {
+        CHIP8& env = m_envs[i];
+
+        if (m_job == JOB_RESET)
+        {
+            if (m_mask != nullptr && !m_mask[i])
+                continue;
+
+            // Keep the per-instance seed which Load() gave this slot.
+            env = m_initial;
+            env.Seed(m_seed + i);
+        }
+        else
+        {
+            uint16_t action = m_actions[i];
+            for (uint8_t k = 0; k < CHIP8_KEY_SIZE; k++)
+                env.SetKey(k, (action >> k) & 0x1);
+
+            CHIP8FaultInfo info = { CHIP8Fault::NONE, 0, 0 };
+            for (unsigned int f = 0; f < m_frame_skip; f++)
+                info = env.RunFrame();
+
+            if (m_faults != nullptr)
+                m_faults[i] = info.fault;
+        }
+
+        _observe(i);
+    }
+};
+
+void VecEnv::_observe(unsigned int i)
+{
+    const uint8_t* screen = m_envs[i].Screen();
+    uint8_t* out = m_obs + i * ObsSize();
+
+    if (m_format == OBS_BYTES)
+    {
+        memcpy(out, screen, CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT);
+        return;
+    }
+
+    m_envs[i].PackScreen(out);
+};
+
+void VecEnv::_dispatch(Job job)
+{
+    unsigned int n = static_cast<unsigned int>(m_envs.size());
+
+    m_job = job;
+
+    if (m_slices > 1)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = m_slices - 1;
+        m_generation++;
+    }
+    m_start.notify_all();
+
+    _run(0, n / m_slices);
+
+    if (m_slices > 1)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_pending == 0; });
+    }
+};
+
+void VecEnv::_worker(unsigned int index)
+{
+    uint64_t seen = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this, seen]() { return m_quit || m_generation != seen; });
+            if (m_quit)
+                return;
+            seen = m_generation;
+        }
+
+        unsigned int n = static_cast<unsigned int>(m_envs.size());
+        _run(n * index / m_slices, n * (index + 1) / m_slices);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0)
+                m_done.notify_one();
+        }
+    }
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CHIP8.h"
+
+// Bytes of one bit-packed observation : 64 pixels per row, 8 pixels per byte.
+#define VECENV_PACKED_SIZE CHIP8_PACKED_SCREEN_SIZE
+
+/* VecEnv
+* Vectorized environment over N CHIP8 instances for batched workloads such as reinforcement learning.
+* Every Step() advances all instances by frame_skip frames on worker threads, and writes the screens
+* straight into a contiguous buffer owned by the caller :
+*       OBS_BYTES  : N * 32 * 64 bytes, one byte (0 or 1) per pixel.
+*       OBS_PACKED : N * 256 bytes, 8 pixels per byte, most significant bit is the leftmost pixel.
+* Neither Step() nor Reset() allocates, and there is no intermediate copy per instance.
+*/
+class VecEnv
+{
+public:
+    enum ObsFormat : uint8_t
+    {
+        OBS_BYTES = 0,
+        OBS_PACKED
+    };
+
+    // Create n instances. threads = 0 uses every core.
+    VecEnv(unsigned int n, unsigned int frame_skip = 1, unsigned int threads = 0, ObsFormat format = OBS_BYTES);
+    ~VecEnv();
+
+    VecEnv(const VecEnv&) = delete;
+    VecEnv& operator=(const VecEnv&) = delete;
+
+    // Load the ROM once and copy it into every instance. Instance i is seeded with seed + i.
+    CHIP8Fault Load(const std::string& filepath, uint32_t seed = 1);
+    CHIP8Fault LoadBytes(const uint8_t* data, size_t size, uint32_t seed = 1);
+
+    // actions[i] is the key mask of instance i : bit k set means key k is held during the step.
+    // obs must hold Size() * ObsSize() bytes. faults is optional and receives one fault per instance.
+    void Step(const uint16_t* actions, uint8_t* obs, CHIP8Fault* faults = nullptr);
+
+    // Restore the instances with mask[i] != 0 to the state right after Load(),
+    // and write their observations. mask = nullptr resets every instance.
+    void Reset(const uint8_t* mask, uint8_t* obs);
+
+    unsigned int Size() const;
+    size_t ObsSize() const;
+    CHIP8& Instance(unsigned int i);
+private:
+    enum Job : uint8_t
+    {
+        JOB_STEP = 0,
+        JOB_RESET
+    };
+
+    // Run the current job on instances [begin, end).
+    void _run(unsigned int begin, unsigned int end);
+    // Split the current job across the workers and the calling thread, then wait for it.
+    void _dispatch(Job job);
+    void _worker(unsigned int index);
+    void _observe(unsigned int i);
+    // Copy the freshly loaded m_initial into every instance.
+    void _spread(uint32_t seed);
+private:
+    std::vector<CHIP8>          m_envs;
+    CHIP8                       m_initial;
+
+    unsigned int                m_frame_skip;
+    ObsFormat                   m_format;
+    uint32_t                    m_seed;
+
+    // Current job, only written by the calling thread before a dispatch.
+    Job                         m_job;
+    const uint16_t              *m_actions;
+    const uint8_t               *m_mask;
+    uint8_t                     *m_obs;
+    CHIP8Fault                  *m_faults;
+
+    // Slice 0 runs on the calling thread, slice i on m_workers[i - 1].
+    unsigned int                m_slices;
+    std::vector<std::thread>    m_workers;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_start;
+    std::condition_variable     m_done;
+    uint64_t                    m_generation;
+    unsigned int                m_pending;
+    bool                        m_quit;
+};
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "CHIP8.h"
+
+/* Golden-frame regression suite
+* Every ROM is run headlessly with a fixed seed and a fixed input script.
+* At each checkpoint frame the screen and the full machine state are hashed
+* and compared, together with the fault the machine stopped on, with the values checked into golden.txt.
+*
+* Usage : ./CHIP8Regress [--update] [rom dir] [golden file] [input script]
+*/
+
+#define REGRESS_SEED 0xC8C8C8C8u
+
+// Frames at which the hashes are taken. The last one also ends the run.
+static const unsigned int s_checkpoints[] = { 1, 30, 60, 120, 300, 600, 1200 };
+
+struct InputEvent
+{
+    unsigned int frame;
+    uint8_t key;
+    uint8_t pressed;
+};
+
+struct Result
+{
+    std::string rom;
+    std::vector<std::string> lines;
+};
+
+static uint64_t HashScreen(const uint8_t* screen)
+{
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (int i = 0; i < CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT; i++)
+    {
+        h ^= screen[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+// Input script format : one "<frame> <key in hex> <0|1>" per line, '#' starts a comment.
+static std::vector<InputEvent> LoadScript(const std::string& filepath)
+{
+    std::vector<InputEvent> events;
+    std::ifstream file(filepath);
+
+    if (!file.is_open())
+    {
+        printf("Regress Error: Cannot open the input script at %s\n", filepath.c_str());
+        exit(1);
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream in(line);
+        unsigned int frame, key, pressed;
+        if (in >> std::dec >> frame >> std::hex >> key >> std::dec >> pressed)
+            events.push_back({ frame, static_cast<uint8_t>(key), static_cast<uint8_t>(pressed) });
+    }
+
+    std::stable_sort(events.begin(), events.end(),
+        [](const InputEvent& a, const InputEvent& b) { return a.frame < b.frame; });
+
+    return events;
+}
+
+static Result RunRom(const std::string& dir, const std::string& rom, const std::vector<InputEvent>& script)
+{
+    Result result;
+    result.rom = rom;
+
+    CHIP8 chip8;
+    CHIP8Fault loaded = chip8.Load(dir + "/" + rom);
+    if (loaded != CHIP8Fault::NONE)
+    {
+        result.lines.push_back(rom + " LOAD " + CHIP8::FaultName(loaded));
+        return result;
+    }
+    chip8.Seed(REGRESS_SEED);
+
+    size_t next_event = 0;
+    size_t next_checkpoint = 0;
+    const size_t checkpoint_count = sizeof(s_checkpoints) / sizeof(s_checkpoints[0]);
+
+    for (unsigned int frame = 1; next_checkpoint < checkpoint_count; frame++)
+    {
+        // Apply the inputs which are scheduled before this frame runs.
+        while (next_event < script.size() && script[next_event].frame <= frame)
+        {
+            chip8.SetKey(script[next_event].key, script[next_event].pressed);
+            next_event++;
+        }
+
+        // A fault stops the machine in place. The state hash leaves the fault out, so the line records it by name.
+        chip8.RunFrame();
+
+        if (frame == s_checkpoints[next_checkpoint])
+        {
+            char line[160];
+            snprintf(line, sizeof(line), "%s %u %016llx %016llx %s",
+                rom.c_str(), frame,
+                static_cast<unsigned long long>(HashScreen(chip8.Screen())),
+                static_cast<unsigned long long>(chip8.Hash()),
+                CHIP8::FaultName(chip8.Fault().fault));
+            result.lines.push_back(line);
+            next_checkpoint++;
+        }
+    }
+
+    return result;
+}
+
+static std::vector<std::string> ListRoms(const std::string& dir)
+{
+    // Every regular file in the ROM directory is part of the suite.
+    std::vector<std::string> roms;
+
+    for (const auto& entry : std::filesystem::directory_iterator(dir))
+        if (entry.is_regular_file())
+            roms.push_back(entry.path().filename().string());
+
+    // Directory order is not stable across file systems.
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+int main(int argc, char* argv[])
+{
+    bool update = false;
+    std::vector<std::string> args;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--update") == 0) update = true;
+        else args.push_back(argv[i]);
+    }
+
+    std::string rom_dir = args.size() > 0 ? args[0] : "../rom";
+    std::string golden_path = args.size() > 1 ? args[1] : "golden.txt";
+    std::string script_path = args.size() > 2 ? args[2] : "input.txt";
+
+    std::vector<InputEvent> script = LoadScript(script_path);
+    std::vector<std::string> roms = ListRoms(rom_dir);
+    std::vector<Result> results(roms.size());
+
+    // Spread the ROMs across all cores. Each job only touches its own CHIP8 and result slot.
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::atomic<size_t> next_job(0);
+    unsigned int worker_count = std::max(1u, std::thread::hardware_concurrency());
+    worker_count = std::min<unsigned int>(worker_count, static_cast<unsigned int>(roms.size()));
+
+    std::vector<std::thread> workers;
+    for (unsigned int w = 0; w < worker_count; w++)
+    {
+        workers.emplace_back([&]() {
+            size_t job;
+            while ((job = next_job++) < roms.size())
+                results[job] = RunRom(rom_dir, roms[job], script);
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+
+    if (update)
+    {
+        std::ofstream golden(golden_path);
+        golden << "# <rom> <frame> <screen hash> <state hash> <fault>" << std::endl;
+        for (const Result& result : results)
+            for (const std::string& line : result.lines)
+                golden << line << std::endl;
+
+        std::cout << "Regress: Updated " << golden_path << " in " << ms << " ms." << std::endl;
+        return 0;
+    }
+
+    std::ifstream golden(golden_path);
+    if (!golden.is_open())
+    {
+        printf("Regress Error: Cannot open the golden file at %s\n", golden_path.c_str());
+        return 1;
+    }
+
+    // Key every golden line by "<rom> <frame>" so the ROM order does not matter.
+    std::map<std::string, std::string> expected;
+    std::string line;
+    while (std::getline(golden, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        expected[line.substr(0, line.find(' ', line.find(' ') + 1))] = line;
+    }
+
+    unsigned int failures = 0;
+    for (const Result& result : results)
+    {
+        for (const std::string& actual : result.lines)
+        {
+            std::string key = actual.substr(0, actual.find(' ', actual.find(' ') + 1));
+            auto it = expected.find(key);
+
+            if (it == expected.end())
+            {
+                std::cout << "MISSING  " << actual << std::endl;
+                failures++;
+            }
+            else
+            {
+                if (it->second != actual)
+                {
+                    std::cout << "MISMATCH " << actual << " (expected " << it->second << ")" << std::endl;
+                    failures++;
+                }
+                expected.erase(it);
+            }
+        }
+    }
+
+    // Golden lines nothing matched : a ROM was removed or renamed, or stopped reaching a checkpoint.
+    for (const auto& unmatched : expected)
+    {
+        std::cout << "NO RESULT " << unmatched.second << std::endl;
+        failures++;
+    }
+
+    std::cout << "Regress: " << roms.size() << " ROMs, " << failures << " failures, "
+              << ms << " ms on " << worker_count << " threads." << std::endl;
+
+    return failures ? 1 : 0;
+}
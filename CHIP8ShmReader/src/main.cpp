@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CHIP8.h"
+#include "SharedFrame.h"
+#include "TerminalRenderer.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/* Shared-memory frame reader
+* Attaches to segments published by CHIP8 --shm <name> and draws them on the terminal.
+* Only the cells which changed are sent and updates are capped at --fps, so watching
+* many instances over SSH stays cheap.
+*
+* Usage : ./CHIP8ShmReader [--braille] [--fps N] <name> [name ...]
+*         ./CHIP8ShmReader --selftest <rom>   fork a local publisher and check every read against its checksum.
+*/
+
+#define SELFTEST_READS 200000
+#define WATCH_DEFAULT_FPS 30
+
+#define WATCH_POLL_MS 5
+// Spare terminal cells between tiled instances.
+#define WATCH_GAP 2
+
+// Terminal width in cells, 80 when it cannot be queried.
+static unsigned int TerminalWidth()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0)
+        return ws.ws_col;
+#endif
+    return 80;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// Watch only ends with Ctrl-C, give the cursor back before leaving.
+static void RestoreCursor(int)
+{
+    const char show[] = "\033[?25h\n";
+    ssize_t written = write(STDOUT_FILENO, show, sizeof(show) - 1);
+    (void)written;
+    _exit(0);
+}
+#endif
+
+struct WatchedInstance
+{
+    std::string name;
+    std::unique_ptr<SharedFrameReader> reader;
+    std::unique_ptr<TerminalRenderer> renderer;
+    unsigned int row, col;
+    uint64_t last;
+};
+
+static int Watch(const std::vector<std::string>& names, TerminalRenderer::Style style, unsigned int fps)
+{
+    std::vector<WatchedInstance> instances;
+
+    // Tile the instances left to right, one header line above each screen.
+    TerminalRenderer probe(style);
+    unsigned int tile_w = probe.Columns() + WATCH_GAP;
+    unsigned int tile_h = probe.Rows() + 1;
+    unsigned int per_line = std::max(1u, (TerminalWidth() + WATCH_GAP) / tile_w);
+
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        WatchedInstance instance;
+        instance.name = names[i];
+        instance.reader = std::make_unique<SharedFrameReader>(names[i]);
+        if (!instance.reader->IsOpen())
+        {
+            printf("Reader Error: Cannot attach to segment %s\n", names[i].c_str());
+            return 1;
+        }
+
+        instance.row = 1 + static_cast<unsigned int>(i / per_line) * tile_h;
+        instance.col = 1 + static_cast<unsigned int>(i % per_line) * tile_w;
+        instance.renderer = std::make_unique<TerminalRenderer>(style, fps, instance.row + 1, instance.col);
+        instance.last = ~0ull;
+        instances.push_back(std::move(instance));
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    signal(SIGINT, RestoreCursor);
+    signal(SIGTERM, RestoreCursor);
+#endif
+
+    // Clear the terminal and hide the cursor, the renderers only draw what changes from here on.
+    fputs("\033[2J\033[?25l", stdout);
+
+    SharedFramePayload payload;
+    std::string out;
+    char header[128];
+
+    while (true)
+    {
+        out.clear();
+
+        for (WatchedInstance& instance : instances)
+        {
+            if (!instance.reader->Read(payload) || payload.frame == instance.last)
+                continue;
+            if (!instance.renderer->Render(payload.screen, out))
+                continue;
+            instance.last = payload.frame;
+
+            int n = snprintf(header, sizeof(header), "\033[%u;%uH%-*.*s", instance.row, instance.col,
+                static_cast<int>(tile_w - WATCH_GAP), static_cast<int>(tile_w - WATCH_GAP),
+                (instance.name + "  frame " + std::to_string(payload.frame) + "  PC " + std::to_string(payload.PC)).c_str());
+            out.append(header, n > 0 ? static_cast<size_t>(n) : 0);
+        }
+
+        if (!out.empty())
+        {
+            fwrite(out.data(), 1, out.size(), stdout);
+            fflush(stdout);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_POLL_MS));
+    }
+}
+
+static int SelfTest(const std::string& rom)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    std::string name = "/chip8-selftest-" + std::to_string(getpid());
+
+    // Create the segment before forking so the reader never races the creation.
+    SharedFramePublisher* publisher = new SharedFramePublisher(name);
+    if (!publisher->IsOpen())
+    {
+        printf("Selftest Error: Cannot create segment %s\n", name.c_str());
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        // Publisher process : run the ROM headlessly and publish every frame as fast as possible.
+        CHIP8 chip8;
+        if (chip8.Load(rom) != CHIP8Fault::NONE)
+            _exit(1);
+
+        for (uint64_t frame = 1; ; frame++)
+        {
+            chip8.SetKey(static_cast<uint8_t>(frame >> 4), (frame & 0x8) != 0);
+            chip8.RunFrame();
+            publisher->Publish(chip8, frame);
+        }
+    }
+
+    SharedFrameReader reader(name);
+    SharedFramePayload payload;
+    unsigned int consistent = 0, torn = 0, busy = 0;
+    uint64_t last = 0, distinct = 0;
+    bool backwards = false;
+
+    for (unsigned int i = 0; i < SELFTEST_READS; i++)
+    {
+        if (!reader.Read(payload, 64))
+        {
+            busy++;
+            continue;
+        }
+
+        if (SharedFrameReader::Checksum(payload) != payload.checksum)
+            torn++;
+        else
+            consistent++;
+
+        if (payload.frame < last)
+            backwards = true;
+        if (payload.frame != last)
+            distinct++;
+        last = payload.frame;
+    }
+
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    delete publisher;
+
+    printf("Selftest: %u consistent reads, %u torn, %u gave up, %llu distinct frames, last frame %llu\n",
+        consistent, torn, busy, static_cast<unsigned long long>(distinct), static_cast<unsigned long long>(last));
+
+    bool ok = torn == 0 && !backwards && consistent > 0 && distinct > 1;
+    printf("Selftest: %s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+#else
+    printf("Selftest Error: POSIX shared memory is not available on this platform.\n");
+    return 1;
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 3 && strcmp(argv[1], "--selftest") == 0)
+        return SelfTest(argv[2]);
+
+    TerminalRenderer::Style style = TerminalRenderer::STYLE_HALF_BLOCK;
+    unsigned int fps = WATCH_DEFAULT_FPS;
+    std::vector<std::string> names;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--braille") == 0)
+            style = TerminalRenderer::STYLE_BRAILLE;
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            fps = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+        else
+            names.push_back(argv[i]);
+    }
+
+    if (!names.empty())
+        return Watch(names, style, fps);
+
+    printf("Usage : ./CHIP8ShmReader [--braille] [--fps N] <name> [name ...]\n");
+    printf("        ./CHIP8ShmReader --selftest <rom>\n");
+    return 1;
+}
@@ -0,0 +1,441 @@
+#include "SessionServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Remove path only if it is a socket, so a mistyped path never deletes a regular file.
+static void UnlinkSocket(const std::string& path)
+{
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path.c_str());
+}
+
+SessionServer::SessionServer(const std::string& path, unsigned int max_sessions)
+    : m_path(path), m_listen(-1), m_epoll(-1), m_stop(false), m_pool(max_sessions), m_next_id(1)
+{
+    sockaddr_un addr;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+
+    m_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listen < 0)
+        return;
+
+    // A server which did not exit cleanly leaves its socket file behind.
+    UnlinkSocket(path);
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = m_listen;
+
+    bool bound = bind(m_listen, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    if (!bound ||
+        listen(m_listen, SOMAXCONN) != 0 ||
+        (m_epoll = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_listen, &ev) != 0)
+    {
+        close(m_listen);
+        m_listen = -1;
+
+        // Whatever is at path belongs to someone else unless this server bound it.
+        if (bound)
+            UnlinkSocket(path);
+    }
+};
+
+SessionServer::~SessionServer()
+{
+    while (!m_clients.empty())
+        _close(m_clients.begin()->first);
+
+    if (m_epoll >= 0)
+        close(m_epoll);
+
+    if (m_listen >= 0)
+    {
+        close(m_listen);
+        UnlinkSocket(m_path);
+    }
+};
+
+bool SessionServer::IsOpen() const
+{
+    return m_listen >= 0;
+};
+
+void SessionServer::Run()
+{
+    epoll_event events[SERVER_MAX_EVENTS];
+
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+        // The timeout only bounds how long a Stop() from another thread takes, signals interrupt the wait.
+        int n = epoll_wait(m_epoll, events, SERVER_MAX_EVENTS, 250);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            printf("chip8d Error: epoll_wait failed (%s)\n", strerror(errno));
+            return;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == m_listen)
+            {
+                _accept();
+                continue;
+            }
+
+            auto it = m_clients.find(fd);
+            if (it == m_clients.end())
+                continue;
+            Client& client = it->second;
+
+            if ((events[i].events & EPOLLIN) && !_read(client))
+                continue;
+
+            // A hangup is only final once everything readable was read.
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                _close(fd);
+                continue;
+            }
+
+            if (!_write(client))
+                continue;
+
+            // Writing may have brought a paused client below the limit, its buffered requests can go on.
+            if (!_process(client) || !_write(client))
+                continue;
+
+            _watch(client);
+        }
+    }
+};
+
+void SessionServer::Stop()
+{
+    m_stop.store(true, std::memory_order_relaxed);
+};
+
+void SessionServer::_accept()
+{
+    while (true)
+    {
+        int fd = accept4(m_listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        Client& client = m_clients[fd];
+        client.fd = fd;
+        client.sent = 0;
+        client.events = EPOLLIN;
+
+        epoll_event ev;
+        ev.events = client.events;
+        ev.data.fd = fd;
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            close(fd);
+            m_clients.erase(fd);
+        }
+    }
+};
+
+bool SessionServer::_read(Client& client)
+{
+    uint8_t data[SERVER_READ_SIZE];
+
+    // Execute each chunk as it comes, so a client sending faster than it reads gets paused early.
+    while (client.out.size() - client.sent < SERVER_MAX_PENDING_OUTPUT)
+    {
+        ssize_t n = recv(client.fd, data, sizeof(data), 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            _close(client.fd);
+            return false;
+        }
+        if (n < 0)
+            break;
+
+        client.in.insert(client.in.end(), data, data + n);
+        if (!_process(client))
+        {
+            _close(client.fd);
+            return false;
+        }
+    }
+
+    return true;
+};
+
+bool SessionServer::_write(Client& client)
+{
+    while (client.sent < client.out.size())
+    {
+        ssize_t n = send(client.fd, client.out.data() + client.sent, client.out.size() - client.sent, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            _close(client.fd);
+            return false;
+        }
+        client.sent += n;
+    }
+
+    if (client.sent == client.out.size())
+    {
+        client.out.clear();
+        client.sent = 0;
+    }
+    return true;
+};
+
+void SessionServer::_close(int fd)
+{
+    // Sessions die with the client which created them, a long-running server would leak them otherwise.
+    for (auto it = m_sessions.begin(); it != m_sessions.end();)
+    {
+        if (it->second.owner == fd)
+        {
+            m_pool.Release(it->second.chip8);
+            it = m_sessions.erase(it);
+        }
+        else
+            it++;
+    }
+
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    m_clients.erase(fd);
+};
+
+bool SessionServer::_process(Client& client)
+{
+    size_t pos = 0;
+
+    while (client.in.size() - pos >= 4 && client.out.size() - client.sent < SERVER_MAX_PENDING_OUTPUT)
+    {
+        const uint8_t* request = client.in.data() + pos;
+        uint32_t length = static_cast<uint32_t>(SessionGet(request, 4));
+
+        // The stream cannot be resynchronized after a bad length, so the client is dropped.
+        if (length < SESSION_REQUEST_HEADER_SIZE - 4 || length > SESSION_MAX_REQUEST - 4)
+            return false;
+        if (client.in.size() - pos < 4 + length)
+            break;
+
+        SessionCommand command = static_cast<SessionCommand>(request[4]);
+        uint32_t id = static_cast<uint32_t>(SessionGet(request + 5, 4));
+        _execute(client, command, id, request + SESSION_REQUEST_HEADER_SIZE, 4 + length - SESSION_REQUEST_HEADER_SIZE);
+
+        pos += 4 + length;
+    }
+
+    client.in.erase(client.in.begin(), client.in.begin() + pos);
+    return true;
+};
+
+void SessionServer::_execute(Client& client, SessionCommand command, uint32_t id, const uint8_t* payload, size_t size)
+{
+    if (command == SessionCommand::VERSION)
+    {
+        uint8_t version[4];
+        for (int i = 0; i < 4; i++)
+            version[i] = static_cast<uint8_t>(SESSION_PROTOCOL_VERSION >> (8 * i));
+        _respond(client, SessionStatus::OK, command, id, version, sizeof(version));
+        return;
+    }
+
+    if (command == SessionCommand::CREATE)
+    {
+        if (size != 4)
+            return _respond(client, SessionStatus::MALFORMED, command, 0);
+
+        CHIP8* chip8 = m_pool.Acquire();
+        if (chip8 == nullptr)
+            return _respond(client, SessionStatus::NO_CAPACITY, command, 0);
+
+        // Pooled machines keep the state of their previous session.
+        chip8->initialize();
+        chip8->Seed(static_cast<uint32_t>(SessionGet(payload, 4)));
+
+        uint32_t created = m_next_id++;
+        Session& session = m_sessions[created];
+        session.chip8 = chip8;
+        session.owner = client.fd;
+        return _respond(client, SessionStatus::OK, command, created);
+    }
+
+    if (command == SessionCommand::LIST)
+    {
+        std::vector<uint32_t> ids;
+        ids.reserve(m_sessions.size());
+        for (const auto& entry : m_sessions)
+            ids.push_back(entry.first);
+        std::sort(ids.begin(), ids.end());
+
+        std::vector<uint8_t> list;
+        list.reserve(4 * ids.size());
+        for (uint32_t listed : ids)
+            SessionPut(list, listed, 4);
+        return _respond(client, SessionStatus::OK, command, id, list.data(), list.size());
+    }
+
+    auto it = m_sessions.find(id);
+    if (it == m_sessions.end())
+    {
+        // The session is gone, and so is any stream of it.
+        client.streams.erase(id);
+        return _respond(client, SessionStatus::NO_SESSION, command, id);
+    }
+    Session& session = it->second;
+    CHIP8& chip8 = *session.chip8;
+
+    // Any client may look at a session, only its owner may change it.
+    bool read_only = command == SessionCommand::GET_FRAME || command == SessionCommand::HASH ||
+                     command == SessionCommand::GET_DELTA;
+    if (!read_only && session.owner != client.fd)
+        return _respond(client, SessionStatus::NO_SESSION, command, id);
+
+    switch (command)
+    {
+    case SessionCommand::DESTROY:
+        m_pool.Release(session.chip8);
+        m_sessions.erase(it);
+        return _respond(client, SessionStatus::OK, command, id);
+
+    case SessionCommand::LOAD:
+    {
+        uint8_t fault = static_cast<uint8_t>(chip8.LoadBytes(payload, size));
+        if (fault != static_cast<uint8_t>(CHIP8Fault::NONE))
+            return _respond(client, SessionStatus::LOAD_FAILED, command, id, &fault, 1);
+        return _respond(client, SessionStatus::OK, command, id);
+    }
+
+    case SessionCommand::SET_KEYS:
+    {
+        if (size != 2)
+            return _respond(client, SessionStatus::MALFORMED, command, id);
+
+        uint16_t keys = static_cast<uint16_t>(SessionGet(payload, 2));
+        for (uint8_t k = 0; k < CHIP8_KEY_SIZE; k++)
+            chip8.SetKey(k, (keys >> k) & 1);
+        return _respond(client, SessionStatus::OK, command, id);
+    }
+
+    case SessionCommand::STEP:
+    {
+        uint32_t frames = size == 4 ? static_cast<uint32_t>(SessionGet(payload, 4)) : 0;
+        if (size != 4 || frames > SESSION_MAX_STEP)
+            return _respond(client, SessionStatus::MALFORMED, command, id);
+
+        CHIP8FaultInfo info = chip8.RunCycles(frames * CHIP8_CYCLES_PER_FRAME);
+        uint8_t result[5] = {
+            static_cast<uint8_t>(info.fault),
+            static_cast<uint8_t>(info.pc), static_cast<uint8_t>(info.pc >> 8),
+            static_cast<uint8_t>(info.opcode), static_cast<uint8_t>(info.opcode >> 8)
+        };
+        return _respond(client, SessionStatus::OK, command, id, result, sizeof(result));
+    }
+
+    case SessionCommand::GET_FRAME:
+    {
+        uint8_t packed[CHIP8_PACKED_SCREEN_SIZE];
+        chip8.PackScreen(packed);
+        return _respond(client, SessionStatus::OK, command, id, packed, sizeof(packed));
+    }
+
+    case SessionCommand::GET_DELTA:
+    {
+        uint8_t packed[CHIP8_PACKED_SCREEN_SIZE];
+        chip8.PackScreen(packed);
+
+        // The first poll of a session creates its encoder, which always starts with a keyframe.
+        m_delta.clear();
+        client.streams[id].Encode(packed, m_delta);
+        return _respond(client, SessionStatus::OK, command, id, m_delta.data(), m_delta.size());
+    }
+
+    case SessionCommand::SNAPSHOT:
+    case SessionCommand::RESTORE:
+    {
+        if (size != 1 || payload[0] >= SESSION_SNAPSHOT_SLOTS)
+            return _respond(client, SessionStatus::MALFORMED, command, id);
+
+        std::unique_ptr<CHIP8State>& slot = session.snapshots[payload[0]];
+        if (command == SessionCommand::SNAPSHOT)
+        {
+            // Slots are only allocated once used, most sessions never take a snapshot.
+            if (slot == nullptr)
+                slot = std::make_unique<CHIP8State>();
+            chip8.Snapshot(*slot);
+            return _respond(client, SessionStatus::OK, command, id);
+        }
+
+        if (slot == nullptr || !chip8.Restore(*slot))
+            return _respond(client, SessionStatus::NO_SNAPSHOT, command, id);
+        return _respond(client, SessionStatus::OK, command, id);
+    }
+
+    case SessionCommand::HASH:
+    {
+        uint8_t hash[8];
+        uint64_t h = chip8.Hash();
+        for (int i = 0; i < 8; i++)
+            hash[i] = static_cast<uint8_t>(h >> (8 * i));
+        return _respond(client, SessionStatus::OK, command, id, hash, sizeof(hash));
+    }
+
+    default:
+        return _respond(client, SessionStatus::UNKNOWN_COMMAND, command, id);
+    }
+};
+
+void SessionServer::_respond(Client& client, SessionStatus status, SessionCommand command, uint32_t id,
+                             const void* payload, size_t size)
+{
+    SessionPut(client.out, SESSION_RESPONSE_HEADER_SIZE - 4 + size, 4);
+    SessionPut(client.out, static_cast<uint8_t>(status), 1);
+    SessionPut(client.out, static_cast<uint8_t>(command), 1);
+    SessionPut(client.out, id, 4);
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+    client.out.insert(client.out.end(), bytes, bytes + size);
+};
+
+void SessionServer::_watch(Client& client)
+{
+    uint32_t events = 0;
+    if (client.out.size() - client.sent < SERVER_MAX_PENDING_OUTPUT)
+        events |= EPOLLIN;
+    if (client.sent < client.out.size())
+        events |= EPOLLOUT;
+
+    if (events == client.events)
+        return;
+
+    epoll_event ev;
+    ev.events = events;
+    ev.data.fd = client.fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, client.fd, &ev);
+    client.events = events;
+};
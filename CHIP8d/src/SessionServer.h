@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CHIP8.h"
+#include "CHIP8Pool.h"
+#include "FrameDelta.h"
+#include "SessionProtocol.h"
+
+// Responses a client may leave unread before the server stops reading its requests.
+#define SERVER_MAX_PENDING_OUTPUT (4 * 1024 * 1024)
+#define SERVER_READ_SIZE (64 * 1024)
+#define SERVER_MAX_EVENTS 256
+
+/* Session server
+* Hosts many CHIP8 sessions in one process behind a Unix stream socket, speaking the session protocol.
+*
+* One thread runs an epoll loop over the listening socket and every client. Each readable client is drained,
+* every complete request in its buffer is executed in order, and the responses are written back together.
+* A client which stops reading its responses stops being read from once SERVER_MAX_PENDING_OUTPUT bytes
+* are waiting, so it cannot grow the server's memory without bound.
+*
+* Machines come from a CHIP8Pool sized at start, so creating a session never allocates one.
+*/
+class SessionServer
+{
+public:
+    SessionServer(const std::string& path, unsigned int max_sessions);
+    // Close every client and unlink the socket.
+    ~SessionServer();
+
+    SessionServer(const SessionServer&) = delete;
+    SessionServer& operator=(const SessionServer&) = delete;
+
+    bool IsOpen() const;
+
+    // Serve until Stop().
+    void Run();
+
+    // Safe to call from a signal handler.
+    void Stop();
+private:
+    struct Client
+    {
+        int fd;
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> out;
+        // Bytes of out already written.
+        size_t sent;
+        // Interest currently registered with epoll.
+        uint32_t events;
+        // Frame stream state of every session this client polled with GET_DELTA.
+        std::unordered_map<uint32_t, FrameDeltaEncoder> streams;
+    };
+
+    struct Session
+    {
+        CHIP8* chip8;
+        int owner;
+        std::unique_ptr<CHIP8State> snapshots[SESSION_SNAPSHOT_SLOTS];
+    };
+
+    void _accept();
+    // Return false when the client is gone and was closed.
+    bool _read(Client& client);
+    bool _write(Client& client);
+    void _close(int fd);
+
+    // Execute every complete request in the input buffer. Return false on a request which cannot be framed.
+    bool _process(Client& client);
+    void _execute(Client& client, SessionCommand command, uint32_t id, const uint8_t* payload, size_t size);
+    void _respond(Client& client, SessionStatus status, SessionCommand command, uint32_t id,
+                  const void* payload = nullptr, size_t size = 0);
+    // Register the interest the client needs now : input while its output is below the limit, output while pending.
+    void _watch(Client& client);
+private:
+    std::string             m_path;
+    int                     m_listen;
+    int                     m_epoll;
+    std::atomic<bool>       m_stop;
+
+    CHIP8Pool               m_pool;
+    std::unordered_map<uint32_t, Session> m_sessions;
+    uint32_t                m_next_id;
+
+    std::unordered_map<int, Client> m_clients;
+
+    // Encoded frame of GET_DELTA, before it is copied into the response.
+    std::vector<uint8_t>    m_delta;
+};
@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CHIP8.h"
+#include "FrameDelta.h"
+#include "SessionClient.h"
+#include "SessionServer.h"
+#include "TerminalRenderer.h"
+
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* chip8d
+* Session server : many emulator instances in one process, driven over a Unix socket with the session protocol.
+*
+* Usage : ./chip8d [--max-sessions N] <socket path>
+*         ./chip8d --watch <socket path> [--braille] [--fps N] [id ...]   draw sessions on the terminal, all by default.
+*         ./chip8d --selftest <rom>   fork a local server and check pipelined batches against local instances.
+*/
+
+#define CHIP8D_DEFAULT_SESSIONS 1024
+
+// Sessions are polled at the emulator frame rate, the terminal is only redrawn at --fps.
+#define WATCH_POLL_HZ 60
+#define WATCH_DEFAULT_FPS 30
+// Spare terminal cells between tiled sessions.
+#define WATCH_GAP 2
+
+#define SELFTEST_SESSIONS 512
+// More rounds than FRAMEDELTA_KEYFRAME_INTERVAL, so the stream sends a periodic keyframe.
+#define SELFTEST_ROUNDS 150
+#define SELFTEST_STEP_FRAMES 2
+// How long the selftest waits for the server to notice a disconnect.
+#define SELFTEST_DISCONNECT_MS 1000
+
+static SessionServer* g_server = nullptr;
+
+static void StopServer(int)
+{
+    if (g_server != nullptr)
+        g_server->Stop();
+}
+
+// Terminal width in cells, 80 when it cannot be queried.
+static unsigned int TerminalWidth()
+{
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0)
+        return ws.ws_col;
+    return 80;
+}
+
+// Watch only ends with Ctrl-C, give the cursor back before leaving.
+static void RestoreCursor(int)
+{
+    const char show[] = "\033[?25h\n";
+    ssize_t written = write(STDOUT_FILENO, show, sizeof(show) - 1);
+    (void)written;
+    _exit(0);
+}
+
+struct WatchedSession
+{
+    uint32_t id;
+    FrameDeltaDecoder decoder;
+    std::unique_ptr<TerminalRenderer> renderer;
+    unsigned int row, col;
+    bool gone;
+};
+
+static int Watch(const std::string& path, std::vector<uint32_t> ids, TerminalRenderer::Style style, unsigned int fps)
+{
+    SessionClient client(path);
+    SessionResponse response;
+    if (!client.IsOpen())
+    {
+        printf("Watch Error: Cannot connect to %s\n", path.c_str());
+        return 1;
+    }
+
+    if (ids.empty())
+    {
+        client.Request(SessionCommand::LIST, 0);
+        if (!client.Flush() || !client.Receive(response) || response.status != SessionStatus::OK)
+        {
+            printf("Watch Error: Cannot list the sessions of %s\n", path.c_str());
+            return 1;
+        }
+        for (size_t i = 0; i + 4 <= response.payload.size(); i += 4)
+            ids.push_back(static_cast<uint32_t>(SessionGet(response.payload.data() + i, 4)));
+    }
+    if (ids.empty())
+    {
+        printf("Watch Error: %s has no sessions\n", path.c_str());
+        return 1;
+    }
+
+    // Tile the sessions left to right, one header line above each screen.
+    TerminalRenderer probe(style);
+    unsigned int tile_w = probe.Columns() + WATCH_GAP;
+    unsigned int tile_h = probe.Rows() + 1;
+    unsigned int per_line = std::max(1u, (TerminalWidth() + WATCH_GAP) / tile_w);
+
+    std::vector<WatchedSession> sessions(ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        sessions[i].id = ids[i];
+        sessions[i].row = 1 + static_cast<unsigned int>(i / per_line) * tile_h;
+        sessions[i].col = 1 + static_cast<unsigned int>(i % per_line) * tile_w;
+        sessions[i].renderer = std::make_unique<TerminalRenderer>(style, fps, sessions[i].row + 1, sessions[i].col);
+        sessions[i].gone = false;
+    }
+    unsigned int status_row = 1 + static_cast<unsigned int>((ids.size() + per_line - 1) / per_line) * tile_h;
+
+    signal(SIGINT, RestoreCursor);
+    signal(SIGTERM, RestoreCursor);
+
+    // Clear the terminal and hide the cursor, the renderers only draw what changes from here on.
+    fputs("\033[2J\033[?25l", stdout);
+
+    uint8_t screen[CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT];
+    std::string out;
+    char line[128];
+    uint64_t received = 0, polls = 0;
+
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / WATCH_POLL_HZ));
+    auto next = std::chrono::steady_clock::now();
+    auto second = next;
+
+    while (true)
+    {
+        // One batch per tick : a delta request for every session, then all the answers.
+        for (const WatchedSession& session : sessions)
+            if (!session.gone)
+                client.Request(SessionCommand::GET_DELTA, session.id);
+        if (!client.Flush())
+            break;
+
+        out.clear();
+        for (WatchedSession& session : sessions)
+        {
+            if (session.gone)
+                continue;
+            if (!client.Receive(response))
+                break;
+            received += SESSION_RESPONSE_HEADER_SIZE + response.payload.size();
+
+            const char* state = nullptr;
+            if (response.status != SessionStatus::OK)
+            {
+                session.gone = true;
+                state = "gone";
+            }
+            else if (!session.decoder.Decode(response.payload.data(), response.payload.size()))
+                continue;
+            else
+            {
+                session.decoder.Unpack(screen);
+                if (!session.renderer->Render(screen, out))
+                    continue;
+                state = "";
+            }
+
+            int n = snprintf(line, sizeof(line), "\033[%u;%uHsession %u %s", session.row, session.col, session.id, state);
+            out.append(line, n > 0 ? static_cast<size_t>(n) : 0);
+        }
+        polls++;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - second >= std::chrono::seconds(1))
+        {
+            double elapsed = std::chrono::duration<double>(now - second).count();
+            int n = snprintf(line, sizeof(line), "\033[%u;1H\033[K%zu sessions, %.0f polls/s, %.0f bytes/s received",
+                status_row, sessions.size(), polls / elapsed, received / elapsed);
+            out.append(line, n > 0 ? static_cast<size_t>(n) : 0);
+            second = now;
+            received = 0;
+            polls = 0;
+        }
+
+        if (!out.empty())
+        {
+            fwrite(out.data(), 1, out.size(), stdout);
+            fflush(stdout);
+        }
+
+        next += period;
+        if (next < now)
+            next = now;
+        std::this_thread::sleep_until(next);
+    }
+
+    fputs("\033[?25h\n", stdout);
+    printf("Watch Error: Connection to %s lost\n", path.c_str());
+    return 1;
+}
+
+// Scripted key mask of one selftest session in one round.
+static uint16_t SelfTestKeys(unsigned int session, unsigned int round)
+{
+    uint32_t h = (session + 1) * 2654435761u ^ (round / 4) * 40503u;
+    return static_cast<uint16_t>(1u << (h >> 28));
+}
+
+static bool Expect(SessionClient& client, SessionStatus status, SessionResponse& response, const char* what)
+{
+    if (!client.Receive(response))
+    {
+        printf("Selftest Error: Connection lost waiting for %s\n", what);
+        return false;
+    }
+    if (response.status != status)
+    {
+        printf("Selftest Error: %s answered status %u, expected %u\n", what,
+            static_cast<unsigned int>(response.status), static_cast<unsigned int>(status));
+        return false;
+    }
+    return true;
+}
+
+static int SelfTest(const std::string& rom_path)
+{
+    std::ifstream file(rom_path, std::ios::binary);
+    std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!file.good() && !file.eof())
+    {
+        printf("Selftest Error: Cannot read %s\n", rom_path.c_str());
+        return 1;
+    }
+
+    std::string path = "/tmp/chip8d-selftest-" + std::to_string(getpid());
+
+    // Listen before forking so the client never races the socket creation.
+    SessionServer* server = new SessionServer(path, SELFTEST_SESSIONS + 1);
+    if (!server->IsOpen())
+    {
+        printf("Selftest Error: Cannot listen on %s\n", path.c_str());
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        server->Run();
+        _exit(0);
+    }
+
+    SessionClient client(path);
+    SessionResponse response;
+    bool ok = client.IsOpen();
+
+    // Local reference instances, stepped exactly like the remote sessions.
+    std::unique_ptr<CHIP8[]> local(new CHIP8[SELFTEST_SESSIONS]);
+    std::vector<uint32_t> ids(SELFTEST_SESSIONS);
+
+    client.Request(SessionCommand::VERSION, 0);
+    for (unsigned int i = 0; i < SELFTEST_SESSIONS; i++)
+    {
+        uint8_t seed[4];
+        for (int b = 0; b < 4; b++)
+            seed[b] = static_cast<uint8_t>((i + 1) >> (8 * b));
+        client.Request(SessionCommand::CREATE, 0, seed, sizeof(seed));
+
+        local[i].Seed(i + 1);
+        local[i].LoadBytes(rom.data(), rom.size());
+    }
+    ok = ok && client.Flush() && Expect(client, SessionStatus::OK, response, "VERSION") &&
+         SessionGet(response.payload.data(), 4) == SESSION_PROTOCOL_VERSION;
+
+    for (unsigned int i = 0; ok && i < SELFTEST_SESSIONS; i++)
+    {
+        ok = Expect(client, SessionStatus::OK, response, "CREATE");
+        ids[i] = response.session;
+    }
+
+    for (unsigned int i = 0; ok && i < SELFTEST_SESSIONS; i++)
+        client.Request(SessionCommand::LOAD, ids[i], rom.data(), rom.size());
+    ok = ok && client.Flush();
+    for (unsigned int i = 0; ok && i < SELFTEST_SESSIONS; i++)
+        ok = Expect(client, SessionStatus::OK, response, "LOAD");
+
+    // A second client streams every session like a viewer, it must see the same screens.
+    SessionClient viewer(path);
+    std::vector<FrameDeltaDecoder> decoders(SELFTEST_SESSIONS);
+    uint64_t stream_bytes = 0, keyframes = 0;
+
+    viewer.Request(SessionCommand::LIST, 0);
+    ok = ok && viewer.IsOpen() && viewer.Flush() && Expect(viewer, SessionStatus::OK, response, "LIST");
+    bool listed = ok && response.payload.size() == 4 * ids.size();
+    for (size_t i = 0; listed && i < ids.size(); i++)
+        listed = SessionGet(response.payload.data() + 4 * i, 4) == ids[i];
+
+    // Every round is one pipelined batch : keys and a step for every session, then all the answers.
+    uint64_t requests = 0, mismatches = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned int round = 0; ok && round < SELFTEST_ROUNDS; round++)
+    {
+        uint8_t frames[4] = { SELFTEST_STEP_FRAMES, 0, 0, 0 };
+        for (unsigned int i = 0; i < SELFTEST_SESSIONS; i++)
+        {
+            uint8_t keys[2];
+            uint16_t mask = SelfTestKeys(i, round);
+            keys[0] = static_cast<uint8_t>(mask);
+            keys[1] = static_cast<uint8_t>(mask >> 8);
+
+            client.Request(SessionCommand::SET_KEYS, ids[i], keys, sizeof(keys));
+            client.Request(SessionCommand::STEP, ids[i], frames, sizeof(frames));
+            client.Request(SessionCommand::GET_FRAME, ids[i]);
+            requests += 3;
+        }
+        ok = client.Flush();
+
+        uint8_t packed[CHIP8_PACKED_SCREEN_SIZE];
+        for (unsigned int i = 0; ok && i < SELFTEST_SESSIONS; i++)
+        {
+            uint16_t mask = SelfTestKeys(i, round);
+            for (uint8_t k = 0; k < CHIP8_KEY_SIZE; k++)
+                local[i].SetKey(k, (mask >> k) & 1);
+            CHIP8FaultInfo info = local[i].RunCycles(SELFTEST_STEP_FRAMES * CHIP8_CYCLES_PER_FRAME);
+            local[i].PackScreen(packed);
+
+            ok = Expect(client, SessionStatus::OK, response, "SET_KEYS") &&
+                 Expect(client, SessionStatus::OK, response, "STEP");
+            if (ok && response.payload[0] != static_cast<uint8_t>(info.fault))
+                mismatches++;
+            ok = ok && Expect(client, SessionStatus::OK, response, "GET_FRAME");
+            if (ok && memcmp(response.payload.data(), packed, sizeof(packed)) != 0)
+                mismatches++;
+        }
+
+        for (unsigned int i = 0; ok && i < SELFTEST_SESSIONS; i++)
+            viewer.Request(SessionCommand::GET_DELTA, ids[i]);
+        requests += SELFTEST_SESSIONS;
+        ok = ok && viewer.Flush();
+
+        for (unsigned int i = 0; ok && i < SELFTEST_SESSIONS; i++)
+        {
+            ok = Expect(viewer, SessionStatus::OK, response, "GET_DELTA");
+            if (!ok)
+                break;
+
+            stream_bytes += response.payload.size();
+            keyframes += response.payload[0] == FRAMEDELTA_KEYFRAME;
+            local[i].PackScreen(packed);
+            if (!decoders[i].Decode(response.payload.data(), response.payload.size()) ||
+                memcmp(decoders[i].Packed(), packed, sizeof(packed)) != 0)
+                mismatches++;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The full states must agree too, not only what is on screen.
+    for (unsigned int i = 0; ok && i < SELFTEST_SESSIONS; i++)
+        client.Request(SessionCommand::HASH, ids[i]);
+    ok = ok && client.Flush();
+    for (unsigned int i = 0; ok && i < SELFTEST_SESSIONS; i++)
+    {
+        ok = Expect(client, SessionStatus::OK, response, "HASH");
+        if (ok && SessionGet(response.payload.data(), 8) != local[i].Hash())
+            mismatches++;
+    }
+
+    // Snapshot, run on, restore : the hash must come back. An unsaved slot must be refused.
+    uint8_t slot = 3, unsaved = 4;
+    uint8_t frames[4] = { 30, 0, 0, 0 };
+    client.Request(SessionCommand::SNAPSHOT, ids[0], &slot, 1);
+    client.Request(SessionCommand::STEP, ids[0], frames, sizeof(frames));
+    client.Request(SessionCommand::RESTORE, ids[0], &slot, 1);
+    client.Request(SessionCommand::HASH, ids[0]);
+    client.Request(SessionCommand::RESTORE, ids[0], &unsaved, 1);
+    ok = ok && client.Flush() &&
+         Expect(client, SessionStatus::OK, response, "SNAPSHOT") &&
+         Expect(client, SessionStatus::OK, response, "STEP") &&
+         Expect(client, SessionStatus::OK, response, "RESTORE") &&
+         Expect(client, SessionStatus::OK, response, "HASH");
+    bool restored = ok && SessionGet(response.payload.data(), 8) == local[0].Hash();
+    ok = ok && Expect(client, SessionStatus::NO_SNAPSHOT, response, "RESTORE of an unsaved slot");
+
+    // Another client may read a session but not change it, and its own sessions die with it.
+    uint32_t orphan = 0;
+    {
+        SessionClient other(path);
+        uint8_t seed[4] = { 0, 0, 0, 0 };
+        other.Request(SessionCommand::HASH, ids[0]);
+        other.Request(SessionCommand::STEP, ids[0], frames, sizeof(frames));
+        other.Request(SessionCommand::CREATE, 0, seed, sizeof(seed));
+        ok = ok && other.IsOpen() && other.Flush() &&
+             Expect(other, SessionStatus::OK, response, "HASH from another client") &&
+             Expect(other, SessionStatus::NO_SESSION, response, "STEP from another client") &&
+             Expect(other, SessionStatus::OK, response, "CREATE");
+        orphan = response.session;
+    }
+
+    bool reaped = false;
+    for (unsigned int waited = 0; ok && !reaped && waited < SELFTEST_DISCONNECT_MS; waited += 10)
+    {
+        client.Request(SessionCommand::HASH, orphan);
+        ok = client.Flush() && client.Receive(response);
+        reaped = ok && response.status == SessionStatus::NO_SESSION;
+        if (!reaped)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    delete server;
+
+    uint64_t emulated = static_cast<uint64_t>(SELFTEST_SESSIONS) * SELFTEST_ROUNDS * SELFTEST_STEP_FRAMES;
+    printf("Selftest: %u sessions, %llu requests in %.3f s, %.0f requests/s, %.0f frames/s\n",
+        SELFTEST_SESSIONS, static_cast<unsigned long long>(requests), seconds,
+        requests / seconds, emulated / seconds);
+    printf("Selftest: stream %.1f bytes/frame against %u raw, %llu keyframes\n",
+        static_cast<double>(stream_bytes) / (static_cast<uint64_t>(SELFTEST_SESSIONS) * SELFTEST_ROUNDS),
+        CHIP8_PACKED_SCREEN_SIZE, static_cast<unsigned long long>(keyframes));
+    printf("Selftest: %llu mismatches, list %s, snapshot %s, disconnect %s\n", static_cast<unsigned long long>(mismatches),
+        listed ? "complete" : "WRONG", restored ? "restored" : "NOT restored", reaped ? "reaped" : "NOT reaped");
+
+    ok = ok && mismatches == 0 && listed && restored && reaped;
+    printf("Selftest: %s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 3 && strcmp(argv[1], "--selftest") == 0)
+        return SelfTest(argv[2]);
+
+    if (argc >= 3 && strcmp(argv[1], "--watch") == 0)
+    {
+        TerminalRenderer::Style style = TerminalRenderer::STYLE_HALF_BLOCK;
+        unsigned int fps = WATCH_DEFAULT_FPS;
+        std::vector<uint32_t> ids;
+
+        for (int i = 3; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--braille") == 0)
+                style = TerminalRenderer::STYLE_BRAILLE;
+            else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+                fps = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+            else
+                ids.push_back(static_cast<uint32_t>(strtoul(argv[i], nullptr, 10)));
+        }
+        return Watch(argv[2], ids, style, fps);
+    }
+
+    unsigned int max_sessions = CHIP8D_DEFAULT_SESSIONS;
+    std::string path;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--max-sessions") == 0 && i + 1 < argc)
+            max_sessions = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+        else
+            path = argv[i];
+    }
+
+    if (path.empty() || max_sessions == 0)
+    {
+        printf("Usage : ./chip8d [--max-sessions N] <socket path>\n");
+        printf("        ./chip8d --watch <socket path> [--braille] [--fps N] [id ...]\n");
+        printf("        ./chip8d --selftest <rom>\n");
+        return 1;
+    }
+
+    SessionServer server(path, max_sessions);
+    if (!server.IsOpen())
+    {
+        printf("chip8d Error: Cannot listen on %s\n", path.c_str());
+        return 1;
+    }
+
+    // No SA_RESTART, so the signal also wakes epoll_wait right away.
+    g_server = &server;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = StopServer;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    printf("chip8d: listening on %s, %u sessions\n", path.c_str(), max_sessions);
+    fflush(stdout);
+    server.Run();
+
+    g_server = nullptr;
+    printf("chip8d: stopped\n");
+    return 0;
+}
@@ -1,14 +1,136 @@
 workspace "CHIP8"
 	architecture "x86_64"
+	startproject "CHIP8"
 
 	configurations
 	{
 		"Debug",
-		"Release"
+		"Release",
+		"ReleasePGO"
 	}
 
+	-- ReleasePGO is built in two stages with the same object directory (see scripts/pgo.sh):
+	--   premake5 <action> --pgo=generate : instrumented LTO build, run CHIP8Bench to record profiles.
+	--   premake5 <action> --pgo=use      : LTO build optimized with the recorded profiles.
+	filter "configurations:ReleasePGO"
+		defines "NDEBUG"
+		optimize "Speed"
+		flags { "LinkTimeOptimization" }
+
+	filter { "configurations:ReleasePGO", "options:pgo=generate", "toolset:not msc*" }
+		buildoptions { "-fprofile-generate", "-fprofile-update=atomic" }
+		linkoptions { "-fprofile-generate" }
+
+	filter { "configurations:ReleasePGO", "options:pgo=use", "toolset:not msc*" }
+		buildoptions { "-fprofile-use", "-fprofile-correction" }
+		linkoptions { "-fprofile-use" }
+
+	filter { "configurations:ReleasePGO", "options:pgo=generate", "toolset:msc*" }
+		linkoptions { "/LTCG:PGInstrument" }
+
+	filter { "configurations:ReleasePGO", "options:pgo=use", "toolset:msc*" }
+		linkoptions { "/LTCG:PGOptimize" }
+
+	filter {}
+
+newoption
+{
+	trigger = "pgo",
+	value = "STAGE",
+	description = "Profile-guided optimization stage of the ReleasePGO configuration",
+	allowed =
+	{
+		{ "generate", "Instrumented build which records profiles" },
+		{ "use", "Optimized build which consumes recorded profiles" }
+	}
+}
+
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 
+-- Emulator core. No SDL dependency, so services and tools can embed it directly.
+project "CHIP8Core"
+	location "CHIP8Core"
+	kind "StaticLib"
+	language "C++"
+	cppdialect "C++17"
+	staticruntime "on"
+	targetname "chip8core"
+	pic "On" -- Linked into the CHIP8C shared library.
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+
+	files
+	{
+		"%{prj.location}/src/**.h",
+		"%{prj.location}/src/**.cpp"
+	}
+
+	includedirs
+	{
+		"%{prj.name}/src"
+	}
+
+	filter "configurations:Debug"
+		defines "DEBUG"
+		symbols "On"
+
+	filter "configurations:Release"
+		defines "NDEBUG"
+		optimize "On"
+
+	filter "system:windows"
+		systemversion "latest"
+
+-- Stable C ABI over the core, shared library for bindings in other languages.
+project "CHIP8C"
+	location "CHIP8C"
+	kind "SharedLib"
+	language "C++"
+	cppdialect "C++17"
+	staticruntime "on"
+	targetname "chip8"
+	visibility "Hidden"
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+
+	files
+	{
+		"%{prj.location}/src/**.h",
+		"%{prj.location}/src/**.cpp"
+	}
+
+	includedirs
+	{
+		"CHIP8Core/src"
+	}
+
+	defines
+	{
+		"CHIP8C_BUILD"
+	}
+
+	links
+	{
+		"CHIP8Core"
+	}
+
+	filter "configurations:Debug"
+		defines "DEBUG"
+		symbols "On"
+
+	filter "configurations:Release"
+		defines "NDEBUG"
+		optimize "On"
+
+	filter "system:windows"
+		systemversion "latest"
+
+	filter "system:linux"
+		links { "pthread" }
+
+-- SDL frontend.
 project "CHIP8"
 	location "CHIP8"
 	kind "ConsoleApp"
@@ -31,7 +153,13 @@ project "CHIP8"
 	includedirs
 	{
 		"%{prj.name}/dependencies/SDL2/include",
-		"%{prj.name}/src"
+		"%{prj.name}/src",
+		"CHIP8Core/src"
+	}
+
+	links
+	{
+		"CHIP8Core"
 	}
 
 	filter "configurations:Debug"
@@ -49,17 +177,179 @@ project "CHIP8"
 		{
 			"%{prj.name}/dependencies/SDL2/lib/x64"
 		}
-	
+
 		links
 		{
 			"SDL2.lib",
 			"SDL2main.lib"
-		}	
+		}
 
 		postbuildcommands
 		{
 			("{COPY} %{prj.location}/dependencies/SDL2/lib/x64/SDL2.dll %{cfg.buildtarget.directory}")
 		}
-	
+
+	filter "system:linux"
+		links { "SDL2", "rt", "pthread" }
+
+-- Golden-frame regression suite.
+project "CHIP8Regress"
+	location "CHIP8Regress"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	staticruntime "on"
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+
+	files
+	{
+		"%{prj.location}/src/**.cpp"
+	}
+
+	includedirs
+	{
+		"CHIP8Core/src"
+	}
+
+	links
+	{
+		"CHIP8Core"
+	}
+
+	filter "configurations:Debug"
+		defines "DEBUG"
+		symbols "On"
+
+	filter "configurations:Release"
+		defines "NDEBUG"
+		optimize "On"
+
+	filter "system:windows"
+		systemversion "latest"
+
+	filter "system:linux"
+		links { "pthread" }
+
+-- Throughput benchmark over every ROM. Also drives the ReleasePGO training run.
+project "CHIP8Bench"
+	location "CHIP8Bench"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	staticruntime "on"
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+
+	files
+	{
+		"%{prj.location}/src/**.cpp"
+	}
+
+	includedirs
+	{
+		"CHIP8Core/src"
+	}
+
+	links
+	{
+		"CHIP8Core"
+	}
+
+	filter "configurations:Debug"
+		defines "DEBUG"
+		symbols "On"
+
+	filter "configurations:Release"
+		defines "NDEBUG"
+		optimize "On"
+
+	filter "system:windows"
+		systemversion "latest"
+
+	-- VecEnv runs its worker pool on std::thread.
+	filter "system:linux"
+		links { "pthread" }
+
+-- Reader for frames published with CHIP8 --shm, with a self-test against a local publisher process.
+project "CHIP8ShmReader"
+	location "CHIP8ShmReader"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	staticruntime "on"
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+
+	files
+	{
+		"%{prj.location}/src/**.cpp"
+	}
+
+	includedirs
+	{
+		"CHIP8Core/src"
+	}
+
+	links
+	{
+		"CHIP8Core"
+	}
+
+	filter "configurations:Debug"
+		defines "DEBUG"
+		symbols "On"
+
+	filter "configurations:Release"
+		defines "NDEBUG"
+		optimize "On"
+
+	filter "system:windows"
+		systemversion "latest"
+
 	filter "system:linux"
-		links { "SDL2" }
+		links { "pthread", "rt" }
+
+-- The session server is built on epoll, so it only exists on Linux.
+if os.istarget("linux") then
+
+project "CHIP8d"
+	location "CHIP8d"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	staticruntime "on"
+	targetname "chip8d"
+
+	targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+	objdir ("bin-int/" .. outputdir .. "/%{prj.name}")
+
+	files
+	{
+		"%{prj.location}/src/**.h",
+		"%{prj.location}/src/**.cpp"
+	}
+
+	includedirs
+	{
+		"CHIP8Core/src"
+	}
+
+	links
+	{
+		"CHIP8Core",
+		"pthread"
+	}
+
+	filter "configurations:Debug"
+		defines "DEBUG"
+		symbols "On"
+
+	filter "configurations:Release"
+		defines "NDEBUG"
+		optimize "On"
+
+end
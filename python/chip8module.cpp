@@ -0,0 +1,575 @@
+/* Python bindings over the CHIP8C ABI.
+*
+*   chip8.Machine : one machine. Exposes its screen through the buffer protocol
+*                   as a read-only (32, 64) uint8 view, e.g. numpy.asarray(machine).
+*   chip8.VecEnv  : batched machines. Exposes its observation buffer through the buffer protocol
+*                   as (N, 32, 64) or (N, 256) uint8, and releases the GIL while stepping.
+*
+* Every view aliases the emulator memory directly, nothing is copied per step.
+*
+* Stepping releases the GIL, so another Python thread may call into the same object meanwhile.
+* Each object carries a busy flag, only touched while holding the GIL, and every method which
+* would race with the running step raises RuntimeError instead.
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "CHIP8C.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////// Machine //////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    PyObject_HEAD
+    chip8_machine* machine;
+    int busy;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} MachineObject;
+
+static PyObject* FaultTuple(chip8_fault_info info)
+{
+    return Py_BuildValue("(iii)", info.fault, info.pc, info.opcode);
+}
+
+// Set the error and return true when the object was never initialized, e.g. made through __new__ alone,
+// or while another thread runs a step on it.
+static bool Unusable(const void* handle, int busy)
+{
+    if (handle == nullptr)
+        PyErr_SetString(PyExc_RuntimeError, "not initialized");
+    else if (busy)
+        PyErr_SetString(PyExc_RuntimeError, "object is in use by another thread");
+    return handle == nullptr || busy != 0;
+}
+
+// Exported views alias the memory of the first machine, so a second __init__ cannot replace it.
+static bool Initialized(const void* handle)
+{
+    if (handle != nullptr)
+        PyErr_SetString(PyExc_RuntimeError, "object is already initialized");
+    return handle != nullptr;
+}
+
+static int Machine_init(MachineObject* self, PyObject* args, PyObject* kwds)
+{
+    static const char* kwlist[] = { "seed", nullptr };
+    unsigned int seed = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|I", const_cast<char**>(kwlist), &seed))
+        return -1;
+    if (Initialized(self->machine))
+        return -1;
+
+    self->machine = chip8_create(seed);
+    if (self->machine == nullptr)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    self->shape[0] = 32;
+    self->shape[1] = 64;
+    self->strides[0] = 64;
+    self->strides[1] = 1;
+    return 0;
+}
+
+static void Machine_dealloc(MachineObject* self)
+{
+    chip8_destroy(self->machine);
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static PyObject* Machine_load(MachineObject* self, PyObject* args)
+{
+    Py_buffer rom;
+    if (Unusable(self->machine, self->busy) || !PyArg_ParseTuple(args, "y*", &rom))
+        return nullptr;
+
+    uint8_t fault = chip8_load_rom(self->machine, static_cast<const uint8_t*>(rom.buf), rom.len);
+    PyBuffer_Release(&rom);
+
+    if (fault == CHIP8C_FAULT_OUT_OF_MEMORY)
+        return PyErr_NoMemory();
+    if (fault != CHIP8C_FAULT_NONE)
+    {
+        PyErr_Format(PyExc_ValueError, "cannot load ROM: %s", chip8_fault_name(fault));
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* Machine_reset(MachineObject* self, PyObject* Py_UNUSED(args))
+{
+    if (Unusable(self->machine, self->busy))
+        return nullptr;
+
+    chip8_reset(self->machine);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Machine_seed(MachineObject* self, PyObject* args)
+{
+    unsigned int seed;
+    if (Unusable(self->machine, self->busy) || !PyArg_ParseTuple(args, "I", &seed))
+        return nullptr;
+
+    chip8_seed(self->machine, seed);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Machine_step(MachineObject* self, PyObject* args)
+{
+    unsigned int frames = 1;
+    if (Unusable(self->machine, self->busy) || !PyArg_ParseTuple(args, "|I", &frames))
+        return nullptr;
+
+    chip8_fault_info info;
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    info = chip8_step(self->machine, frames);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    return FaultTuple(info);
+}
+
+static PyObject* Machine_set_keys(MachineObject* self, PyObject* args)
+{
+    unsigned int mask;
+    if (Unusable(self->machine, self->busy) || !PyArg_ParseTuple(args, "I", &mask))
+        return nullptr;
+
+    chip8_set_keys(self->machine, static_cast<uint16_t>(mask));
+    Py_RETURN_NONE;
+}
+
+static PyObject* Machine_snapshot(MachineObject* self, PyObject* Py_UNUSED(args))
+{
+    if (Unusable(self->machine, self->busy))
+        return nullptr;
+
+    PyObject* state = PyBytes_FromStringAndSize(nullptr, chip8_snapshot_size());
+    if (state == nullptr)
+        return nullptr;
+
+    chip8_snapshot(self->machine, PyBytes_AS_STRING(state));
+    return state;
+}
+
+static PyObject* Machine_restore(MachineObject* self, PyObject* args)
+{
+    Py_buffer state;
+    if (Unusable(self->machine, self->busy) || !PyArg_ParseTuple(args, "y*", &state))
+        return nullptr;
+
+    uint8_t fault = CHIP8C_FAULT_BAD_SNAPSHOT;
+    if (static_cast<size_t>(state.len) == chip8_snapshot_size())
+        fault = chip8_restore(self->machine, state.buf);
+    PyBuffer_Release(&state);
+
+    if (fault != CHIP8C_FAULT_NONE)
+    {
+        PyErr_SetString(PyExc_ValueError, "invalid snapshot");
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static int Machine_getbuffer(MachineObject* self, Py_buffer* view, int flags)
+{
+    if (self->machine == nullptr)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "not initialized");
+        return -1;
+    }
+    if (flags & PyBUF_WRITABLE)
+    {
+        PyErr_SetString(PyExc_BufferError, "the screen is read-only");
+        return -1;
+    }
+
+    view->obj = reinterpret_cast<PyObject*>(self);
+    Py_INCREF(self);
+    view->buf = const_cast<uint8_t*>(chip8_screen(self->machine));
+    view->len = 32 * 64;
+    view->readonly = 1;
+    view->itemsize = 1;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>("B") : nullptr;
+    view->ndim = 2;
+    view->shape = (flags & PyBUF_ND) ? self->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+static PyBufferProcs Machine_as_buffer = { reinterpret_cast<getbufferproc>(Machine_getbuffer), nullptr };
+
+static PyMethodDef Machine_methods[] = {
+    { "load", reinterpret_cast<PyCFunction>(Machine_load), METH_VARARGS, "load(rom: bytes) : load a ROM image and reset the machine." },
+    { "reset", reinterpret_cast<PyCFunction>(Machine_reset), METH_NOARGS, "reset() : back to the state right after load(), keeping the random state." },
+    { "seed", reinterpret_cast<PyCFunction>(Machine_seed), METH_VARARGS, "seed(seed: int) : reseed the random number generator." },
+    { "step", reinterpret_cast<PyCFunction>(Machine_step), METH_VARARGS, "step(frames=1) -> (fault, pc, opcode)" },
+    { "set_keys", reinterpret_cast<PyCFunction>(Machine_set_keys), METH_VARARGS, "set_keys(mask: int) : bit k holds key k." },
+    { "snapshot", reinterpret_cast<PyCFunction>(Machine_snapshot), METH_NOARGS, "snapshot() -> bytes" },
+    { "restore", reinterpret_cast<PyCFunction>(Machine_restore), METH_VARARGS, "restore(state: bytes)" },
+    { nullptr, nullptr, 0, nullptr }
+};
+
+static PyTypeObject MachineType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////// VecEnv ///////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+    PyObject_HEAD
+    chip8_vec* vec;
+    uint8_t* obs;
+    uint8_t* faults;
+    uint16_t* actions;
+    int busy;
+    Py_ssize_t obs_len;
+    int ndim;
+    Py_ssize_t shape[3];
+    Py_ssize_t strides[3];
+} VecEnvObject;
+
+static int VecEnv_init(VecEnvObject* self, PyObject* args, PyObject* kwds)
+{
+    static const char* kwlist[] = { "n", "frame_skip", "threads", "packed", nullptr };
+    unsigned int n, frame_skip = 1, threads = 0;
+    int packed = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "I|IIp", const_cast<char**>(kwlist), &n, &frame_skip, &threads, &packed))
+        return -1;
+    if (Initialized(self->vec))
+        return -1;
+
+    self->vec = chip8_vec_create(n, frame_skip, threads, packed ? CHIP8C_OBS_PACKED : CHIP8C_OBS_BYTES);
+    if (self->vec == nullptr)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    size_t obs_size = chip8_vec_obs_size(self->vec);
+    self->obs_len = static_cast<Py_ssize_t>(n * obs_size);
+    self->obs = static_cast<uint8_t*>(PyMem_Calloc(n ? n * obs_size : 1, 1));
+    self->faults = static_cast<uint8_t*>(PyMem_Calloc(n ? n : 1, 1));
+    self->actions = static_cast<uint16_t*>(PyMem_Calloc(n ? n : 1, sizeof(uint16_t)));
+    if (self->obs == nullptr || self->faults == nullptr || self->actions == nullptr)
+    {
+        // Leave the object uninitialized, the methods check vec alone.
+        chip8_vec_destroy(self->vec);
+        self->vec = nullptr;
+        PyMem_Free(self->obs);
+        PyMem_Free(self->faults);
+        PyMem_Free(self->actions);
+        self->obs = nullptr;
+        self->faults = nullptr;
+        self->actions = nullptr;
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    if (packed)
+    {
+        self->ndim = 2;
+        self->shape[0] = n;             self->shape[1] = 256;
+        self->strides[0] = 256;         self->strides[1] = 1;
+    }
+    else
+    {
+        self->ndim = 3;
+        self->shape[0] = n;             self->shape[1] = 32;    self->shape[2] = 64;
+        self->strides[0] = 32 * 64;     self->strides[1] = 64;  self->strides[2] = 1;
+    }
+    return 0;
+}
+
+static void VecEnv_dealloc(VecEnvObject* self)
+{
+    if (self->vec != nullptr)
+        chip8_vec_destroy(self->vec);
+    PyMem_Free(self->obs);
+    PyMem_Free(self->faults);
+    PyMem_Free(self->actions);
+    Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static PyObject* VecEnv_load(VecEnvObject* self, PyObject* args, PyObject* kwds)
+{
+    static const char* kwlist[] = { "rom", "seed", nullptr };
+    Py_buffer rom;
+    unsigned int seed = 1;
+    if (Unusable(self->vec, self->busy) || !PyArg_ParseTupleAndKeywords(args, kwds, "y*|I", const_cast<char**>(kwlist), &rom, &seed))
+        return nullptr;
+
+    uint8_t fault = chip8_vec_load_rom(self->vec, static_cast<const uint8_t*>(rom.buf), rom.len, seed);
+    PyBuffer_Release(&rom);
+
+    if (fault != CHIP8C_FAULT_NONE)
+    {
+        PyErr_Format(PyExc_ValueError, "cannot load ROM: %s", chip8_fault_name(fault));
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+// Native 16 bits integers only : a float16 or byte-swapped buffer has the right size but not the right values.
+static bool IsKeyMaskFormat(const char* format)
+{
+    // No format means unsigned bytes.
+    if (format == nullptr)
+        return false;
+    if (*format == '@' || *format == '=' || *format == (PY_LITTLE_ENDIAN ? '<' : '>'))
+        format++;
+    return (format[0] == 'H' || format[0] == 'h') && format[1] == '\0';
+}
+
+// Resolve the optional caller-provided output buffer. Fall back to the internal one.
+static uint8_t* VecEnv_output(VecEnvObject* self, PyObject* out, Py_buffer* view)
+{
+    view->obj = nullptr;
+    if (out == nullptr || out == Py_None)
+        return self->obs;
+
+    if (PyObject_GetBuffer(out, view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) < 0)
+        return nullptr;
+
+    if (view->len != self->obs_len)
+    {
+        PyErr_Format(PyExc_ValueError, "out must hold %zd bytes", self->obs_len);
+        PyBuffer_Release(view);
+        return nullptr;
+    }
+    return static_cast<uint8_t*>(view->buf);
+}
+
+static PyObject* VecEnv_step(VecEnvObject* self, PyObject* args, PyObject* kwds)
+{
+    static const char* kwlist[] = { "actions", "out", nullptr };
+    PyObject* actions_obj;
+    PyObject* out = nullptr;
+
+    if (Unusable(self->vec, self->busy) || !PyArg_ParseTupleAndKeywords(args, kwds, "O|O", const_cast<char**>(kwlist), &actions_obj, &out))
+        return nullptr;
+
+    uint32_t n = chip8_vec_size(self->vec);
+    const uint16_t* actions = nullptr;
+    Py_buffer actions_view;
+    actions_view.obj = nullptr;
+
+    // Accept any contiguous uint16 buffer (array('H'), numpy uint16) without copying,
+    // or a sequence of ints which is converted into the preallocated action array.
+    if (PyObject_CheckBuffer(actions_obj))
+    {
+        if (PyObject_GetBuffer(actions_obj, &actions_view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+            return nullptr;
+        if (!IsKeyMaskFormat(actions_view.format) || actions_view.len != static_cast<Py_ssize_t>(n * 2))
+        {
+            PyBuffer_Release(&actions_view);
+            PyErr_Format(PyExc_ValueError, "actions must be %u uint16 key masks", n);
+            return nullptr;
+        }
+        actions = static_cast<const uint16_t*>(actions_view.buf);
+    }
+    else
+    {
+        PyObject* seq = PySequence_Fast(actions_obj, "actions must be a buffer or a sequence");
+        if (seq == nullptr)
+            return nullptr;
+        if (PySequence_Fast_GET_SIZE(seq) != static_cast<Py_ssize_t>(n))
+        {
+            Py_DECREF(seq);
+            PyErr_Format(PyExc_ValueError, "actions must hold %u key masks", n);
+            return nullptr;
+        }
+        for (uint32_t i = 0; i < n; i++)
+            self->actions[i] = static_cast<uint16_t>(PyLong_AsUnsignedLong(PySequence_Fast_GET_ITEM(seq, i)));
+        Py_DECREF(seq);
+        if (PyErr_Occurred())
+            return nullptr;
+        actions = self->actions;
+    }
+
+    Py_buffer out_view;
+    uint8_t* obs = VecEnv_output(self, out, &out_view);
+    if (obs == nullptr)
+    {
+        if (actions_view.obj != nullptr) PyBuffer_Release(&actions_view);
+        return nullptr;
+    }
+
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    chip8_vec_step(self->vec, actions, obs, self->faults);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    if (actions_view.obj != nullptr) PyBuffer_Release(&actions_view);
+    if (out_view.obj != nullptr) PyBuffer_Release(&out_view);
+
+    // Faults are rare, report them as a list of (index, fault) instead of a full array.
+    PyObject* faults = PyList_New(0);
+    for (uint32_t i = 0; faults != nullptr && i < n; i++)
+    {
+        if (self->faults[i] == CHIP8C_FAULT_NONE)
+            continue;
+        PyObject* item = Py_BuildValue("(Ii)", i, self->faults[i]);
+        if (item == nullptr || PyList_Append(faults, item) < 0)
+            Py_CLEAR(faults);
+        Py_XDECREF(item);
+    }
+    return faults;
+}
+
+static PyObject* VecEnv_reset(VecEnvObject* self, PyObject* args, PyObject* kwds)
+{
+    static const char* kwlist[] = { "mask", "out", nullptr };
+    PyObject* mask_obj = nullptr;
+    PyObject* out = nullptr;
+
+    if (Unusable(self->vec, self->busy) || !PyArg_ParseTupleAndKeywords(args, kwds, "|OO", const_cast<char**>(kwlist), &mask_obj, &out))
+        return nullptr;
+
+    Py_buffer mask_view;
+    mask_view.obj = nullptr;
+    const uint8_t* mask = nullptr;
+
+    if (mask_obj != nullptr && mask_obj != Py_None)
+    {
+        if (PyObject_GetBuffer(mask_obj, &mask_view, PyBUF_C_CONTIGUOUS) < 0)
+            return nullptr;
+        if (mask_view.len != static_cast<Py_ssize_t>(chip8_vec_size(self->vec)))
+        {
+            PyBuffer_Release(&mask_view);
+            PyErr_SetString(PyExc_ValueError, "mask must hold one byte per environment");
+            return nullptr;
+        }
+        mask = static_cast<const uint8_t*>(mask_view.buf);
+    }
+
+    Py_buffer out_view;
+    uint8_t* obs = VecEnv_output(self, out, &out_view);
+    if (obs == nullptr)
+    {
+        if (mask_view.obj != nullptr) PyBuffer_Release(&mask_view);
+        return nullptr;
+    }
+
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    chip8_vec_reset(self->vec, mask, obs);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    if (mask_view.obj != nullptr) PyBuffer_Release(&mask_view);
+    if (out_view.obj != nullptr) PyBuffer_Release(&out_view);
+    Py_RETURN_NONE;
+}
+
+static PyObject* VecEnv_len(VecEnvObject* self, PyObject* Py_UNUSED(args))
+{
+    if (Unusable(self->vec, 0))
+        return nullptr;
+
+    return PyLong_FromUnsignedLong(chip8_vec_size(self->vec));
+}
+
+static int VecEnv_getbuffer(VecEnvObject* self, Py_buffer* view, int flags)
+{
+    if (self->vec == nullptr)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "not initialized");
+        return -1;
+    }
+    if (flags & PyBUF_WRITABLE)
+    {
+        PyErr_SetString(PyExc_BufferError, "observations are read-only");
+        return -1;
+    }
+
+    view->obj = reinterpret_cast<PyObject*>(self);
+    Py_INCREF(self);
+    view->buf = self->obs;
+    view->len = self->obs_len;
+    view->readonly = 1;
+    view->itemsize = 1;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>("B") : nullptr;
+    view->ndim = self->ndim;
+    view->shape = (flags & PyBUF_ND) ? self->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+static PyBufferProcs VecEnv_as_buffer = { reinterpret_cast<getbufferproc>(VecEnv_getbuffer), nullptr };
+
+static PyMethodDef VecEnv_methods[] = {
+    { "load", reinterpret_cast<PyCFunction>(VecEnv_load), METH_VARARGS | METH_KEYWORDS, "load(rom: bytes, seed=1) : environment i is seeded with seed + i." },
+    { "step", reinterpret_cast<PyCFunction>(VecEnv_step), METH_VARARGS | METH_KEYWORDS, "step(actions, out=None) -> [(index, fault)]" },
+    { "reset", reinterpret_cast<PyCFunction>(VecEnv_reset), METH_VARARGS | METH_KEYWORDS, "reset(mask=None, out=None)" },
+    { "size", reinterpret_cast<PyCFunction>(VecEnv_len), METH_NOARGS, "size() -> number of environments" },
+    { nullptr, nullptr, 0, nullptr }
+};
+
+static PyTypeObject VecEnvType = { PyVarObject_HEAD_INIT(nullptr, 0) };
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////// Module ///////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+static struct PyModuleDef chip8_module = {
+    PyModuleDef_HEAD_INIT, "chip8", "CHIP-8 emulator core bindings.", -1, nullptr
+};
+
+PyMODINIT_FUNC PyInit_chip8(void)
+{
+    MachineType.tp_name = "chip8.Machine";
+    MachineType.tp_basicsize = sizeof(MachineObject);
+    MachineType.tp_flags = Py_TPFLAGS_DEFAULT;
+    MachineType.tp_doc = "Single CHIP-8 machine. Supports the buffer protocol over its 32x64 screen.";
+    MachineType.tp_new = PyType_GenericNew;
+    MachineType.tp_init = reinterpret_cast<initproc>(Machine_init);
+    MachineType.tp_dealloc = reinterpret_cast<destructor>(Machine_dealloc);
+    MachineType.tp_methods = Machine_methods;
+    MachineType.tp_as_buffer = &Machine_as_buffer;
+
+    VecEnvType.tp_name = "chip8.VecEnv";
+    VecEnvType.tp_basicsize = sizeof(VecEnvObject);
+    VecEnvType.tp_flags = Py_TPFLAGS_DEFAULT;
+    VecEnvType.tp_doc = "Batched CHIP-8 machines. Supports the buffer protocol over the observation buffer.";
+    VecEnvType.tp_new = PyType_GenericNew;
+    VecEnvType.tp_init = reinterpret_cast<initproc>(VecEnv_init);
+    VecEnvType.tp_dealloc = reinterpret_cast<destructor>(VecEnv_dealloc);
+    VecEnvType.tp_methods = VecEnv_methods;
+    VecEnvType.tp_as_buffer = &VecEnv_as_buffer;
+
+    if (PyType_Ready(&MachineType) < 0 || PyType_Ready(&VecEnvType) < 0)
+        return nullptr;
+
+    PyObject* module = PyModule_Create(&chip8_module);
+    if (module == nullptr)
+        return nullptr;
+
+    Py_INCREF(&MachineType);
+    Py_INCREF(&VecEnvType);
+    if (PyModule_AddObject(module, "Machine", reinterpret_cast<PyObject*>(&MachineType)) < 0 ||
+        PyModule_AddObject(module, "VecEnv", reinterpret_cast<PyObject*>(&VecEnvType)) < 0)
+    {
+        Py_DECREF(module);
+        return nullptr;
+    }
+
+    PyModule_AddIntConstant(module, "ABI_VERSION", chip8_abi_version());
+    return module;
+}
@@ -0,0 +1,41 @@
+# Build the chip8 Python extension.
+# The CHIP8C ABI and the core sources are compiled straight into the extension,
+# so the module has no runtime dependency on a separately installed libchip8.
+#
+#   cd python && python setup.py build_ext --inplace
+
+import glob
+import os
+import sys
+
+from setuptools import Extension, setup
+
+ROOT = os.path.dirname(os.path.abspath(__file__))
+CORE = os.path.join("..", "CHIP8Core", "src")
+CABI = os.path.join("..", "CHIP8C", "src")
+
+if sys.platform == "win32":
+    compile_args = ["/std:c++17", "/O2"]
+    link_args = []
+else:
+    compile_args = ["-std=c++17", "-O2", "-fvisibility=hidden"]
+    link_args = ["-pthread"]
+
+os.chdir(ROOT)
+
+setup(
+    name="chip8",
+    version="0.1.0",
+    description="CHIP-8 emulator core bindings",
+    ext_modules=[
+        Extension(
+            "chip8",
+            sources=["chip8module.cpp", os.path.join(CABI, "CHIP8C.cpp")] + sorted(glob.glob(os.path.join(CORE, "*.cpp"))),
+            include_dirs=[CORE, CABI],
+            define_macros=[("CHIP8C_BUILD", "1")],
+            extra_compile_args=compile_args,
+            extra_link_args=link_args,
+            language="c++",
+        )
+    ],
+)
@@ -0,0 +1,51 @@
+#!/bin/bash
+# Build the ReleasePGO configuration and report its speedup against Release.
+#
+#   1. Release            : baseline build, benchmarked for comparison.
+#   2. ReleasePGO generate: instrumented LTO build, CHIP8Bench --train over rom/ records the profiles.
+#   3. ReleasePGO use     : LTO build of the profiled targets (CHIP8Bench and the chip8core it links)
+#                           laid out by the recorded profiles, benchmarked. The other projects have
+#                           no profiles, and the SDL frontend would also need SDL installed.
+#
+# Usage : ./scripts/pgo.sh [training frames] [benchmark frames]
+set -e
+# A failing CHIP8Bench must stop the script, not hand an empty total to awk.
+set -o pipefail
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TRAIN_FRAMES="${1:-50000}"
+BENCH_FRAMES="${2:-200000}"
+JOBS="$(nproc 2>/dev/null || echo 4)"
+SYSTEM="linux-x86_64"
+
+cd "$ROOT"
+
+bench()
+{
+    "$ROOT/bin/$1-$SYSTEM/CHIP8Bench/CHIP8Bench" --frames "$2" "${@:3}" "$ROOT/rom"
+}
+
+echo "== Release"
+premake5 gmake
+make -j"$JOBS" config=release CHIP8Bench
+RELEASE="$(bench Release "$BENCH_FRAMES" | awk '/^Bench: total/ { print $3 }')"
+
+echo "== ReleasePGO : generate"
+premake5 gmake --pgo=generate
+make config=releasepgo clean
+make -j"$JOBS" config=releasepgo CHIP8Bench
+# Emulation only, the microbenchmarks would pull the profiles away from the cycle loop.
+bench ReleasePGO "$TRAIN_FRAMES" --train > /dev/null
+
+echo "== ReleasePGO : use"
+# Clean the objects but keep the .gcda profiles next to them.
+find "$ROOT/bin-int" -path "*ReleasePGO*" -name "*.o" -delete
+premake5 gmake --pgo=use
+make -j"$JOBS" config=releasepgo CHIP8Bench
+PGO="$(bench ReleasePGO "$BENCH_FRAMES" | awk '/^Bench: total/ { print $3 }')"
+
+awk -v r="$RELEASE" -v p="$PGO" 'BEGIN {
+    printf("Release    : %.2f Mcycles/s\n", r);
+    printf("ReleasePGO : %.2f Mcycles/s\n", p);
+    printf("Speedup    : %.2fx\n", p / r);
+}'